@@ -7,32 +7,70 @@
 #include "pump_mgr.h"
 #include "settings.h"
 #include "transaction_fsm.h"
+#include "trx_journal.h"
+#include "trx_store.h"
+#include "trx_upload.h"
 #include "ui.h"
 
+#if GKL_MAX_LINKS < SETTINGS_MAX_LINKS
+#error "GKL_MAX_LINKS must cover every link Settings can describe"
+#endif
+
+/* Arena allocations are aligned for the GKL DMA buffers (cache lines) */
+#define APP_ARENA_ALIGN  (32u)
+#define APP_ARENA_ROUND(n)  (((n) + APP_ARENA_ALIGN - 1u) & ~(APP_ARENA_ALIGN - 1u))
+
+/* Static arena for the per-site objects (links, FSMs); by default room for
+   every link and pump Settings can describe, the boot log reports actual
+   usage. A smaller override drops the pumps that do not fit, with a log. */
+#ifndef APP_ARENA_SIZE
+#define APP_ARENA_SIZE   (SETTINGS_MAX_LINKS * APP_ARENA_ROUND(sizeof(PumpProtoGKL)) + \
+                          SETTINGS_MAX_PUMPS * APP_ARENA_ROUND(sizeof(TransactionFSM)))
+#endif
+
+/* Upper bound on the journal records read back at boot (about 1 ms each).
+   The walk stops at the newest acknowledged sale, so normally only the
+   unacknowledged tail is read; the whole ring only when the host has not
+   acknowledged anything for ~TRX_JOURNAL_CAPACITY / 3 sales. */
+#ifndef APP_JOURNAL_REPLAY_MAX
+#define APP_JOURNAL_REPLAY_MAX  (TRX_JOURNAL_CAPACITY)
+#endif
+
 typedef struct {
-    /* Protocol */
-    PumpProtoGKL gkl1;
-    PumpProto proto1;
-    
-    PumpProtoGKL gkl2;
-    PumpProto proto2;
-    
+    /* Protocol: one instance per link used by Settings (carved from the arena) */
+    PumpProtoGKL *gkl[SETTINGS_MAX_LINKS];
+    PumpProto proto[SETTINGS_MAX_LINKS];
+    uint8_t link_count;
+
     /* Manager */
     PumpMgr mgr;
-    
-    /* FSM */
-    TransactionFSM trk1_fsm;
-    TransactionFSM trk2_fsm;
-    
+
+    /* FSM: one per configured pump (carved from the arena) */
+    TransactionFSM *fsm[SETTINGS_MAX_PUMPS];
+    uint8_t fsm_count;
+
     /* Settings */
     Settings settings;
-    
+    bool settings_dirty;    /* runtime prices changed, save when possible */
+
+    /* Transaction journal (same EEPROM as the settings) */
+    TrxJournal journal;
+    bool journal_open[SETTINGS_MAX_PUMPS];  /* preset journalled, no sale or idle yet */
+
+    /* Sales history (lives in D2 SRAM, see app.c) */
+    TrxStore *store;
+    TrxUpload upload;
+
     /* UI */
     UI_Context ui;
-    
+
 } AppContext;
 
-void APP_Init(UART_HandleTypeDef *huart_trk1, UART_HandleTypeDef *huart_trk2, I2C_HandleTypeDef *hi2c);
+/**
+ * @param uarts       UART per link index (Settings pump.link selects one)
+ * @param uart_count  Entries in uarts[]
+ */
+void APP_Init(UART_HandleTypeDef *const *uarts, uint8_t uart_count, I2C_HandleTypeDef *hi2c);
 void APP_Task(void);
 void APP_OnKeyPress(char key);
 
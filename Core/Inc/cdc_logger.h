@@ -16,6 +16,7 @@ extern "C" {
 
 void CDC_LOG_Init(void);
 void CDC_LOG_Push(const char *s);
+void CDC_LOG_PushBytes(const uint8_t *s, uint32_t len);   /* binary, same all-or-nothing rule */
 void CDC_LOG_Task(void);
 
 /**
@@ -27,6 +28,9 @@ void CDC_Log(const char *msg);
 void CDC_LOG_TxCpltCallback(void);
 uint32_t CDC_LOG_GetDroppedCount(void);
 
+/* Bytes that can be pushed now without dropping (for paged output) */
+uint32_t CDC_LOG_GetFree(void);
+
 #ifdef __cplusplus
 }
 #endif
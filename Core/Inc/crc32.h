@@ -0,0 +1,18 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Standard CRC-32 (poly 0xEDB88320, init/xorout 0xFFFFFFFF), as in settings */
+uint32_t CRC32_Update(uint32_t crc, const uint8_t *data, uint32_t len);
+uint32_t CRC32_Calc(const uint8_t *data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC32_H */
@@ -0,0 +1,103 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    fixed_dec.h
+  * @brief   Fixed-point decimal arithmetic for volume and money.
+  *
+  * Units (all unsigned 32-bit, the unit is in every name):
+  *  - cL     centilitres: pump protocol volumes and totalizers
+  *  - dL     decilitres:  FSM, UI and sales store volumes
+  *  - mdL    1/1000 dL:   interpolated volumes
+  *  - money  minor currency units
+  *  - price  minor currency units per litre
+  *
+  * Goals:
+  *  - Checked operations: overflow and division by zero return false and
+  *    leave the output untouched, they never wrap or trap.
+  *  - Explicit rounding (fiscal rules differ: money is rounded half up,
+  *    a preset limit is rounded down so it is never exceeded).
+  *  - One 64-bit multiply and at most one divide, no loops. Not constant
+  *    time: the Cortex-M7 has no 64-bit divide, so the divide is a call to
+  *    __aeabi_uldivmod whose run time depends on the operands.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#ifndef FIXED_DEC_H
+#define FIXED_DEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FIXDEC_CL_PER_DL        (10u)
+#define FIXDEC_MDL_PER_DL       (1000u)
+#define FIXDEC_DL_PER_L         (10u)
+
+/* Largest value of an 8-digit BCD field (4 bytes) in the GKL protocol */
+#define FIXDEC_BCD8_MAX         (99999999u)
+
+/* Largest value of a 4-digit BCD field (2 bytes): the price in V, M and T */
+#define FIXDEC_BCD4_MAX         (9999u)
+
+/* Rounding applied to money figures derived from volume x price */
+#ifndef FIXDEC_MONEY_ROUND
+#define FIXDEC_MONEY_ROUND      FIXDEC_ROUND_HALF_UP
+#endif
+
+/* Rounding of pump cL volumes to the dL used internally */
+#ifndef FIXDEC_VOLUME_ROUND
+#define FIXDEC_VOLUME_ROUND     FIXDEC_ROUND_HALF_UP
+#endif
+
+typedef enum
+{
+    FIXDEC_ROUND_DOWN = 0,      /* toward zero */
+    FIXDEC_ROUND_UP,            /* away from zero */
+    FIXDEC_ROUND_HALF_UP,       /* nearest, ties away from zero */
+    FIXDEC_ROUND_HALF_EVEN      /* nearest, ties to even (banker's) */
+} FixDecRound;
+
+/**
+ * @brief out = round(a * b / d).
+ * @return false on d == 0 or a result above 32 bits.
+ */
+bool FixDec_MulDiv(uint32_t a, uint32_t b, uint32_t d, FixDecRound r, uint32_t *out);
+
+/**
+ * @brief out = a + b.
+ * @return false on overflow.
+ */
+bool FixDec_Add(uint32_t a, uint32_t b, uint32_t *out);
+
+/* dL -> cL (exact); false on overflow */
+bool FixDec_DLToCL(uint32_t volume_dL, uint32_t *volume_cL);
+
+/* cL -> dL, rounded (never fails) */
+uint32_t FixDec_CLToDL(uint32_t volume_cL, FixDecRound r);
+
+/* Money for a volume: volume_dL * price / 10 */
+bool FixDec_MoneyOfDL(uint32_t volume_dL, uint32_t price, FixDecRound r, uint32_t *money);
+
+/* Money for an interpolated volume: volume_mdL * price / 10000 */
+bool FixDec_MoneyOfMDL(uint32_t volume_mdL, uint32_t price, FixDecRound r, uint32_t *money);
+
+/* Volume a sum of money buys: money * 10 / price; false if price is 0 */
+bool FixDec_DLOfMoney(uint32_t money, uint32_t price, FixDecRound r, uint32_t *volume_dL);
+
+/**
+ * @brief Parse "25.5" (litres, optional one-dot fraction) into dL.
+ *        Fraction digits beyond the first are rounded down.
+ * @return false on a string without digits ("", "."), a bad character
+ *         or overflow.
+ */
+bool FixDec_ParseDL(const char *s, uint8_t len, uint32_t *volume_dL);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIXED_DEC_H */
@@ -8,6 +8,11 @@
   * - No CPU blocking for protocol traffic
   * - Multiple UART instances supported (USART2/USART3/...)
   * - One request in-flight per UART link
+  * - Each request may carry a completion slot owned by its originator:
+  *   the matching reply (or the failure) is delivered there, so several
+  *   layers can share one link without reading each other's replies
+  * - Frames that match no outstanding request go to a separate
+  *   unsolicited slot instead of failing the request
   *
   * Frame format (per spec):
   *   <0x02><ctrl><slave><cmd><data...><xor_checksum>
@@ -36,9 +41,10 @@ extern "C" {
 #define GKL_RESP_TIMEOUT_MS            (100u)  /* ts */
 #define GKL_RESP_DELAY_MIN_MS          (3u)   /* td (slave delays response) */
 
-/* How many UART links we can register in the global callbacks dispatcher */
+/* How many UART links we can register in the global callbacks dispatcher
+   (must cover PUMP_MGR_MAX_LINKS, checked in app.h) */
 #ifndef GKL_MAX_LINKS
-#define GKL_MAX_LINKS                  (4u)
+#define GKL_MAX_LINKS                  (8u)
 #endif
 
 /* Raw RX logging buffer size (debug).
@@ -78,6 +84,15 @@ typedef struct
     uint8_t checksum;                    /* XOR checksum */
 } GKL_Frame;
 
+/* Completion slot: owned by whoever sent the request, written from the
+   UART IRQ (done is set last), read and cleared by the owner */
+typedef struct
+{
+    volatile uint8_t done;              /* 1 = result (and frame if OK) valid */
+    volatile GKL_Result result;
+    GKL_Frame frame;
+} GKL_Completion;
+
 typedef struct
 {
     /* Connection health: consecutive failed exchanges (timeout/crc/format/uart) */
@@ -93,6 +108,13 @@ typedef struct
     uint8_t  rx_len;                    /* current rx buffer length */
     uint32_t rx_total_bytes;            /* lifetime counter */
     uint32_t rx_total_frames;           /* lifetime parsed frames */
+    uint32_t rx_unsolicited;            /* frames matching no outstanding request */
+
+    /* Bus time accounting (lifetime, ms); idle = wall time - tx - wait - rx */
+    uint32_t time_tx_ms;                /* request on the wire */
+    uint32_t time_wait_ms;              /* TX done -> first response byte (or timeout) */
+    uint32_t time_rx_ms;                /* first response byte -> frame end */
+    uint32_t exchanges;                 /* finished request/response exchanges */
 } GKL_Stats;
 
 typedef struct
@@ -119,14 +141,30 @@ typedef struct
     volatile uint32_t rx_total_bytes;
     volatile uint32_t rx_total_frames;
 
-    /* Response */
+    /* Response: to the request's completion slot, else kept here */
+    GKL_Completion *completion;
     volatile uint8_t resp_ready;
     GKL_Frame last_resp;
 
+    /* Unsolicited frame (newest wins) */
+    volatile uint8_t unsol_ready;
+    GKL_Frame unsol;
+    volatile uint32_t rx_unsolicited;
+
     /* Timing */
     volatile uint32_t tx_done_ms;
     volatile uint32_t last_rx_byte_ms;
 
+    /* Bus time accounting (see GKL_Stats) */
+    volatile uint32_t time_tx_ms;
+    volatile uint32_t time_wait_ms;
+    volatile uint32_t time_rx_ms;
+    volatile uint32_t exchanges;
+    volatile uint32_t acct_tx_start_ms;
+    volatile uint32_t acct_rx_start_ms;
+    volatile uint8_t  acct_active;       /* exchange in progress */
+    volatile uint8_t  acct_phase;        /* 0 = TX, 1 = wait, 2 = RX */
+
     /* Expected response command for current request */
     volatile char expected_resp_cmd;
 
@@ -145,7 +183,9 @@ typedef struct
 
 /**
  * @brief  Bind module to a UART and start RX.
- * @note   Call once after MX_USARTx_UART_Init().
+ * @note   Call once after MX_USARTx_UART_Init(). With more than
+ *         GKL_MAX_LINKS UARTs the link is not started and last_error is
+ *         GKL_ERR_PARAM.
  */
 void GKL_Init(GKL_Link *link, UART_HandleTypeDef *huart);
 
@@ -166,6 +206,20 @@ GKL_Result GKL_Send(GKL_Link *link,
                     uint8_t data_len,
                     char expected_resp_cmd);
 
+/**
+ * @brief  Like GKL_Send(), but the reply or the failure goes to *done
+ *         (cleared here) instead of GKL_GetResponse(); the link is idle
+ *         again as soon as done is set. done == NULL behaves as GKL_Send().
+ */
+GKL_Result GKL_SendEx(GKL_Link *link,
+                      uint8_t ctrl,
+                      uint8_t slave,
+                      char cmd,
+                      const uint8_t *data,
+                      uint8_t data_len,
+                      char expected_resp_cmd,
+                      GKL_Completion *done);
+
 /**
  * @brief  True if a response frame is ready to be consumed via GKL_GetResponse().
  */
@@ -176,6 +230,11 @@ bool GKL_HasResponse(GKL_Link *link);
  */
 bool GKL_GetResponse(GKL_Link *link, GKL_Frame *out);
 
+/**
+ * @brief  Take the last frame that matched no outstanding request.
+ */
+bool GKL_GetUnsolicited(GKL_Link *link, GKL_Frame *out);
+
 /**
  * @brief  Get stats (connection, last error, state).
  */
@@ -0,0 +1,64 @@
+#ifndef HOST_CMD_H
+#define HOST_CMD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "trx_store.h"
+#include "trx_upload.h"
+#include "transaction_fsm.h"
+
+/*
+ * Line commands from the USB CDC host, answers through the CDC logger.
+ * - OnRx() is called from CDC_Receive_FS (USB IRQ), only copies bytes.
+ * - Task() parses lines and pages long answers out as the logger drains.
+ *
+ *   HIST <pump|0> <from_ms> <to_ms> [nozzle]  -> SALE ... lines, then END <n>
+ *   SUM  <pump|0> <from_ms> <to_ms> [nozzle]  -> SUM <n> <volume_dL> <money>
+ *   STORE                                     -> STORE <count> <capacity> <oldest> <next> <backlog>
+ *   UPL [R]                                   -> binary batch (see trx_upload.h), R = resend after ACK cursor
+ *   ACK <seq>                                 -> ACK <seq> | ERR
+ *   MET <pump>                                -> MET <pump> <name> <n> <avg> <max> <buckets...>
+ *                                                per metric (see trx_metrics.h), then END <n>
+ *   PRICE <pump|0> <price> [<pump> <price>...] -> PRICE <pumps> | ERR; atomic update job,
+ *                                                pump 0 = every pump (see PumpMgr_PriceJobStart)
+ *   PRICE                                     -> PRICE <state> <generation> (PumpPriceJobState)
+ */
+
+#ifndef HOST_CMD_RX_SIZE
+#define HOST_CMD_RX_SIZE        (256u)
+#endif
+
+#ifndef HOST_CMD_LINE_MAX
+#define HOST_CMD_LINE_MAX       (128u)
+#endif
+
+/* Logger space kept free before each paged line, and lines per pass */
+#ifndef HOST_CMD_LINE_ROOM
+#define HOST_CMD_LINE_ROOM      (128u)
+#endif
+#ifndef HOST_CMD_LINES_PER_PASS
+#define HOST_CMD_LINES_PER_PASS (4u)
+#endif
+
+/* Highest price accepted by PRICE (sent as 4 BCD digits in V/M) */
+#ifndef HOST_CMD_PRICE_MAX
+#define HOST_CMD_PRICE_MAX      (9999u)
+#endif
+
+/* Logger space kept free before each MET line (one per metric) */
+#ifndef HOST_CMD_MET_ROOM
+#define HOST_CMD_MET_ROOM       (192u)
+#endif
+
+void HostCmd_Init(PumpMgr *mgr, TrxStore *store, TrxUpload *upload, TransactionFSM *const *fsm, uint8_t fsm_count);
+void HostCmd_OnRx(const uint8_t *buf, uint32_t len);
+void HostCmd_Task(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_CMD_H */
@@ -16,47 +16,379 @@ extern "C" {
 
 #include "pump_proto.h"
 
+/* Pump ids and table indexes are uint8_t and PUMP_MGR_NO_INDEX (0xFF) marks
+   an empty slot, so one manager takes at most 255 pumps */
 #ifndef PUMP_MGR_MAX_PUMPS
-#define PUMP_MGR_MAX_PUMPS   (4u)
+#define PUMP_MGR_MAX_PUMPS   (32u)
 #endif
+#if PUMP_MGR_MAX_PUMPS > 255u
+#error "PUMP_MGR_MAX_PUMPS above 255 collides with PUMP_MGR_NO_INDEX"
+#endif
+
+/* Distinct protocol links (UARTs) the manager can address */
+#ifndef PUMP_MGR_MAX_LINKS
+#define PUMP_MGR_MAX_LINKS   (8u)
+#endif
+
+/* Highest slave address on one link (GasKitLink: 1..32) */
+#ifndef PUMP_MGR_MAX_SLAVE_ADDR
+#define PUMP_MGR_MAX_SLAVE_ADDR   (32u)
+#endif
+
+/* Empty slot marker in lookup tables */
+#define PUMP_MGR_NO_INDEX    (0xFFu)
+
+/* Status poll period while nozzle is up / armed / dispensing (ms).
+   Idle pumps use poll_period_ms given to PumpMgr_Init(). */
+#ifndef PUMP_MGR_POLL_FAST_MS
+#define PUMP_MGR_POLL_FAST_MS      (100u)
+#endif
+
+/* Assumed duration of one request/response exchange (ms) until the link
+   has measured its own; spaces poll phases on a shared bus */
+#ifndef PUMP_MGR_EXCHANGE_EST_MS
+#define PUMP_MGR_EXCHANGE_EST_MS   (30u)
+#endif
+
+/* First probe interval for a quarantined pump (ms); doubled after every
+   failed probe up to PUMP_MGR_PROBE_MAX_MS */
+#ifndef PUMP_MGR_POLL_OFFLINE_MS
+#define PUMP_MGR_POLL_OFFLINE_MS   (500u)
+#endif
+
+#ifndef PUMP_MGR_PROBE_MAX_MS
+#define PUMP_MGR_PROBE_MAX_MS      (4000u)
+#endif
+
+/* Consecutive failures of one pump after which it is quarantined
+   (keep in line with PUMP_GKL_NO_CONNECT_THRESHOLD) */
+#ifndef PUMP_MGR_OFFLINE_FAILS
+#define PUMP_MGR_OFFLINE_FAILS     (10u)
+#endif
+
+/* Read attempts before PumpMgr_Snapshot() gives up (only an ISR that
+   preempted the writer can exhaust them) */
+#ifndef PUMP_MGR_SNAPSHOT_RETRIES
+#define PUMP_MGR_SNAPSHOT_RETRIES  (4u)
+#endif
+
+/* Bus utilisation governor: utilisation is measured over windows of
+   PUMP_MGR_UTIL_WINDOW_MS; above the target, background polls (idle pumps,
+   quarantine probes) are stretched up to PUMP_MGR_STRETCH_MAX times. */
+#ifndef PUMP_MGR_UTIL_WINDOW_MS
+#define PUMP_MGR_UTIL_WINDOW_MS        (1000u)
+#endif
+
+#ifndef PUMP_MGR_UTIL_TARGET_PERMILLE
+#define PUMP_MGR_UTIL_TARGET_PERMILLE  (700u)
+#endif
+
+#ifndef PUMP_MGR_UTIL_HYST_PERMILLE
+#define PUMP_MGR_UTIL_HYST_PERMILLE    (100u)
+#endif
+
+#ifndef PUMP_MGR_STRETCH_MAX
+#define PUMP_MGR_STRETCH_MAX           (8u)
+#endif
+
+/* Totalizer cache: nozzles per pump, age after which an entry is refreshed
+   in the background, and minimum spacing of totalizer reads on one bus */
+#ifndef PUMP_MGR_MAX_NOZZLES
+#define PUMP_MGR_MAX_NOZZLES           (6u)
+#endif
+
+#ifndef PUMP_MGR_TOT_MAX_AGE_MS
+#define PUMP_MGR_TOT_MAX_AGE_MS        (60000u)
+#endif
+
+#ifndef PUMP_MGR_TOT_GAP_MS
+#define PUMP_MGR_TOT_GAP_MS            (250u)
+#endif
+
+/* Default time a station-wide price update may take before it is abandoned.
+   A pump confirms only at idle, so this must cover a full sale already
+   running when the job starts (hang-up included). */
+#ifndef PUMP_MGR_PRICE_JOB_TIMEOUT_MS
+#define PUMP_MGR_PRICE_JOB_TIMEOUT_MS  (600000u)
+#endif
+
+/* Change subscribers: one transaction FSM per pump plus the site-wide ones
+   (app price and totalizer hooks, UI, one spare). Handles are uint8_t. */
+#ifndef PUMP_MGR_FIXED_SUBS
+#define PUMP_MGR_FIXED_SUBS        (4u)
+#endif
+#ifndef PUMP_MGR_MAX_SUBS
+#define PUMP_MGR_MAX_SUBS          (((PUMP_MGR_MAX_PUMPS + PUMP_MGR_FIXED_SUBS) > 255u) ? 255u : \
+                                    (PUMP_MGR_MAX_PUMPS + PUMP_MGR_FIXED_SUBS))
+#endif
+
+/* Change kinds, combined as a mask in PumpMgr_Subscribe() */
+#define PUMP_MGR_NOTIFY_STATUS     (0x01u)  /* status or nozzle changed */
+#define PUMP_MGR_NOTIFY_FAIL       (0x02u)  /* exchange with the pump failed */
+#define PUMP_MGR_NOTIFY_TOTALIZER  (0x04u)  /* totalizer reading arrived */
+#define PUMP_MGR_NOTIFY_PRICE      (0x08u)  /* price changed */
+#define PUMP_MGR_NOTIFY_REPLY      (0x10u)  /* reply to a non-status command */
+#define PUMP_MGR_NOTIFY_ALL        (0x1Fu)
+
+/* Link health of one pump */
+typedef enum
+{
+    PUMP_HEALTH_ONLINE = 0,
+    PUMP_HEALTH_QUARANTINED     /* not answering: probed with exponential backoff */
+} PumpHealth;
 
+/* Cold per-pump data: configuration and diagnostics. Only touched when a
+   pump is actually polled or reported; the per-pass scans use PumpMgrHot. */
 typedef struct
 {
+    /* Sequence lock: odd while the manager is updating this pump (cold and hot fields) */
+    volatile uint32_t seq;
+
     uint8_t      id;
-    PumpProto    proto;
+    uint8_t      link;          /* index into PumpMgr.bus[] */
 
     uint8_t      ctrl_addr;
     uint8_t      slave_addr;
 
+    uint8_t      nozzle_count;  /* 1..PUMP_MGR_MAX_NOZZLES, totalizers kept per nozzle */
+    uint8_t      last_error;
+
     uint32_t     price;
+    uint32_t     last_status_ms;
+    uint32_t     last_seen_ms;  /* any valid reply (status or other command) */
+    uint32_t     last_flow_ms;  /* last status of a sale in progress (2..7): totalizers read later are final */
+
+    uint32_t     probe_backoff_ms;
+    uint32_t     quarantine_count;
+} PumpDevice;
+
+/* Hot scheduler state as parallel arrays indexed like PumpMgr.pumps[]:
+   due-time checks and status-change detection walk a few contiguous
+   cache lines instead of striding over whole PumpDevice records. */
+typedef struct
+{
+    uint32_t     next_poll_ms[PUMP_MGR_MAX_PUMPS];
+    uint8_t      urgent[PUMP_MGR_MAX_PUMPS];        /* one-shot, served before periodic polls */
+    uint8_t      status[PUMP_MGR_MAX_PUMPS];
+    uint8_t      nozzle[PUMP_MGR_MAX_PUMPS];
+    uint8_t      health[PUMP_MGR_MAX_PUMPS];        /* PumpHealth */
+    uint8_t      fail_count[PUMP_MGR_MAX_PUMPS];    /* consecutive failed exchanges */
+} PumpMgrHot;
+
+/* One cached totalizer reading */
+typedef struct
+{
+    uint32_t     value;         /* protocol units (GasKitLink: cL) */
+    uint32_t     stamp_ms;      /* HAL_GetTick() of the reading */
+    uint8_t      valid;         /* 0 = never read or invalidated by a sale */
+} PumpTotalizer;
+
+/* Coherent copy of a pump's state, see PumpMgr_Snapshot() */
+typedef struct
+{
+    uint8_t      id;
+    uint8_t      ctrl_addr;
+    uint8_t      slave_addr;
 
     uint8_t      status;
     uint8_t      nozzle;
 
+    uint8_t      last_error;
+    uint8_t      fail_count;
+
+    uint8_t      health;        /* PumpHealth */
+    uint32_t     probe_backoff_ms;  /* current probe interval while quarantined */
+    uint32_t     quarantine_count;  /* times the pump went into quarantine */
+
+    uint32_t     price;
     uint32_t     last_status_ms;
+    uint32_t     last_seen_ms;
 
-    uint8_t      last_error;
+    uint32_t     seq;           /* version the copy was taken at (changes on every update) */
+} PumpSnapshot;
+
+/* Payload of one change notification */
+typedef struct
+{
+    uint8_t      pump_id;
+    uint8_t      what;          /* single PUMP_MGR_NOTIFY_* bit */
+
+    uint8_t      status;        /* STATUS: new values */
+    uint8_t      nozzle;
+    uint8_t      prev_status;   /* STATUS: value before the change */
+
+    uint8_t      error_code;    /* FAIL */
     uint8_t      fail_count;
-} PumpDevice;
 
+    uint8_t      nozzle_idx;    /* TOTALIZER */
+    uint32_t     totalizer;
+
+    uint32_t     price;         /* PRICE */
+
+    uint8_t      cmd;           /* REPLY: command letter, decoded value */
+    uint32_t     value;
+} PumpMgrNotify;
+
+/* Called from PumpMgr_Task()/setters in main-loop context; keep it short */
+typedef void (*PumpMgrNotifyFn)(void *ctx, const PumpMgrNotify *n);
+
+typedef struct
+{
+    PumpMgrNotifyFn fn;         /* NULL = free slot */
+    void        *ctx;
+    uint8_t      pump_id;       /* 0 = all pumps */
+    uint8_t      mask;
+} PumpMgrSub;
+
+/* Station-wide price update, see PumpMgr_PriceJobStart() */
+typedef enum
+{
+    PUMP_PRICE_JOB_IDLE = 0,
+    PUMP_PRICE_JOB_PENDING,     /* waiting for every pump to confirm a safe point */
+    PUMP_PRICE_JOB_COMMITTED,   /* all new prices applied at once */
+    PUMP_PRICE_JOB_ABORTED      /* timed out, old prices kept everywhere */
+} PumpPriceJobState;
+
+typedef struct
+{
+    uint8_t      id;
+    uint32_t     price;
+} PumpPriceEntry;
+
+typedef struct
+{
+    uint8_t      state;         /* PumpPriceJobState */
+    uint8_t      member[PUMP_MGR_MAX_PUMPS];    /* 1 = pump is part of the job */
+    uint8_t      confirmed[PUMP_MGR_MAX_PUMPS]; /* 1 = idle status seen since start */
+    uint32_t     price[PUMP_MGR_MAX_PUMPS];
+    uint32_t     start_ms;
+    uint32_t     deadline_ms;
+} PumpPriceJob;
+
+/* One physical link (UART) and the pumps wired to it.
+   Built once by PumpMgr_Add(); PumpMgr_Task() drives each bus exactly once per pass. */
+typedef struct
+{
+    PumpProto   proto;
+    uint8_t     dev[PUMP_MGR_MAX_PUMPS];    /* device indexes on this bus */
+    uint8_t     dev_count;
+
+    /* Utilisation accounting */
+    PumpBusTime win_start;          /* link totals at window start */
+    uint32_t    win_start_ms;
+    uint16_t    util_permille;      /* smoothed busy share */
+    uint16_t    tx_permille;        /* last window shares */
+    uint16_t    wait_permille;
+    uint16_t    rx_permille;
+    uint8_t     stretch;            /* background poll multiplier, 1 = none */
+
+    /* Totalizer refresh: round-robin position and earliest next read */
+    uint16_t    tot_cursor;
+    uint32_t    tot_next_ms;
+} PumpMgrBus;
+
+/* Per-bus utilisation, see PumpMgr_GetBusStats() */
 typedef struct
 {
-    PumpDevice  pumps[PUMP_MGR_MAX_PUMPS];
+    uint16_t     util_permille;     /* smoothed busy share of wall time */
+    uint16_t     tx_permille;       /* last window: TX / wait / RX / idle */
+    uint16_t     wait_permille;
+    uint16_t     rx_permille;
+    uint16_t     idle_permille;
+    uint8_t      stretch;           /* current background poll multiplier */
+    uint8_t      dev_count;
+    uint32_t     exchanges;         /* lifetime */
+} PumpMgrBusStats;
+
+typedef struct
+{
+    PumpDevice  pumps[PUMP_MGR_MAX_PUMPS];  /* cold */
     uint8_t     count;
 
-    uint32_t    poll_period_ms;
-    uint32_t    next_poll_ms[PUMP_MGR_MAX_PUMPS];
+    /* Bus topology (devices grouped by link) */
+    PumpMgrBus  bus[PUMP_MGR_MAX_LINKS];
+    uint8_t     bus_count;
+
+    /* O(1) lookup: pump id -> index, (link, slave) -> index */
+    uint8_t     index_by_id[256];
+    uint8_t     index_by_addr[PUMP_MGR_MAX_LINKS][PUMP_MGR_MAX_SLAVE_ADDR + 1u];
+
+    /* Poll periods by pump state */
+    uint32_t    poll_period_ms;     /* idle (nozzle down) */
+    uint32_t    poll_fast_ms;       /* nozzle up / armed / dispensing */
+    uint32_t    poll_offline_ms;    /* first probe interval when quarantined */
+
+    /* Governor target (busy share, permille) */
+    uint16_t    util_target_permille;
+
+    /* Earliest-deadline-first schedule and live status (hot) */
+    PumpMgrHot  hot;
+
+    /* Totalizer cache (main-loop only), per pump and nozzle 1..6 */
+    PumpTotalizer tot[PUMP_MGR_MAX_PUMPS][PUMP_MGR_MAX_NOZZLES];
+    uint8_t     tot_want[PUMP_MGR_MAX_PUMPS];   /* nozzle bits to read at next idle slot */
+
+    /* Price update job and generation of the committed price table */
+    PumpPriceJob price_job;
+    uint32_t    price_gen;
+
+    /* Change subscriptions */
+    PumpMgrSub  subs[PUMP_MGR_MAX_SUBS];
 } PumpMgr;
 
 void PumpMgr_Init(PumpMgr *m, uint32_t poll_period_ms);
+
+/**
+ * @brief Override state-dependent poll periods (0 keeps current value).
+ */
+void PumpMgr_SetPollRates(PumpMgr *m, uint32_t idle_ms, uint32_t fast_ms, uint32_t offline_ms);
 bool PumpMgr_Add(PumpMgr *m, uint8_t id, PumpProto *proto, uint8_t ctrl_addr, uint8_t slave_addr);
 
+/**
+ * @brief Set bus utilisation above which background polls are stretched.
+ */
+void PumpMgr_SetUtilTarget(PumpMgr *m, uint16_t permille);
+bool PumpMgr_GetBusStats(const PumpMgr *m, uint8_t bus, PumpMgrBusStats *out);
+
 PumpDevice *PumpMgr_Get(PumpMgr *m, uint8_t id);
 const PumpDevice *PumpMgr_GetConst(const PumpMgr *m, uint8_t id);
 
+/**
+ * @brief Lock-free consistent copy of one pump's state (seqlock reader).
+ * @note  Never blocks the manager. Safe from any context; returns false only
+ *        if the pump is unknown or an ISR keeps catching an update in progress.
+ */
+bool PumpMgr_Snapshot(const PumpMgr *m, uint8_t id, PumpSnapshot *out);
+
+/**
+ * @brief Subscribe to changes of one pump (pump_id) or all pumps (0).
+ * @param mask  PUMP_MGR_NOTIFY_* bits
+ * @return Handle for PumpMgr_Unsubscribe(), 0 if no free slot.
+ */
+uint8_t PumpMgr_Subscribe(PumpMgr *m, uint8_t pump_id, uint8_t mask, PumpMgrNotifyFn fn, void *ctx);
+void PumpMgr_Unsubscribe(PumpMgr *m, uint8_t handle);
+
 bool PumpMgr_SetPrice(PumpMgr *m, uint8_t id, uint32_t price);
 uint32_t PumpMgr_GetPrice(const PumpMgr *m, uint8_t id);
 
+/**
+ * @brief Start an atomic price update for the listed pumps.
+ * @note  Every pump is polled at once on all links; the new table is committed
+ *        in one step after each pump reported idle (quarantined pumps take it
+ *        with their next preset). Presets are refused meanwhile, see
+ *        PumpMgr_CanAuthorise(). timeout_ms 0 = PUMP_MGR_PRICE_JOB_TIMEOUT_MS.
+ * @return false if a job is already pending or the table is invalid.
+ */
+bool PumpMgr_PriceJobStart(PumpMgr *m, const PumpPriceEntry *table, uint8_t count, uint32_t timeout_ms);
+PumpPriceJobState PumpMgr_PriceJobState(const PumpMgr *m);
+uint32_t PumpMgr_GetPriceGeneration(const PumpMgr *m);
+
+/**
+ * @brief May the pump be authorised (preset) now? False while a price update
+ *        involving it is pending.
+ */
+bool PumpMgr_CanAuthorise(const PumpMgr *m, uint8_t id);
+
 bool PumpMgr_SetSlaveAddr(PumpMgr *m, uint8_t id, uint8_t slave_addr);
 uint8_t PumpMgr_GetSlaveAddr(const PumpMgr *m, uint8_t id);
 
@@ -65,9 +397,32 @@ uint8_t PumpMgr_GetCtrlAddr(const PumpMgr *m, uint8_t id);
 
 void PumpMgr_ClearFail(PumpMgr *m, uint8_t id);
 void PumpMgr_RequestPollNow(PumpMgr *m, uint8_t id);
+/**
+ * @brief Poll every pump again, phases spread over one idle period (no burst).
+ */
 void PumpMgr_RequestPollAllNow(PumpMgr *m);
 
+bool PumpMgr_SetNozzleCount(PumpMgr *m, uint8_t id, uint8_t count);
+uint8_t PumpMgr_GetNozzleCount(const PumpMgr *m, uint8_t id);
+
+/**
+ * @brief Cached totalizer of one nozzle (1..6); never touches the bus.
+ * @return false if pump/nozzle unknown; out->valid tells if a reading exists.
+ */
+bool PumpMgr_GetTotalizer(const PumpMgr *m, uint8_t id, uint8_t nozzle, PumpTotalizer *out);
+
+/**
+ * @brief Ask for fresh totalizers of a pump (0 = all pumps); read in idle bus slots.
+ */
+void PumpMgr_RefreshTotalizers(PumpMgr *m, uint8_t id);
+
 PumpProtoResult PumpMgr_RequestTotalizer(PumpMgr *mgr, uint8_t pump_id, uint8_t nozzle);
+
+/**
+ * @brief Hand in a totalizer another owner read on the link (the FSM's own
+ *        'C'): cached and notified as if the manager had read it.
+ */
+void PumpMgr_PutTotalizer(PumpMgr *m, uint8_t id, uint8_t nozzle, uint32_t value);
 bool PumpMgr_PopEvent(PumpMgr *m, PumpEvent *out);
 void PumpMgr_Task(PumpMgr *m);
 
@@ -33,7 +33,8 @@ typedef enum
     PUMP_EVT_NONE = 0,
     PUMP_EVT_STATUS,
     PUMP_EVT_ERROR,
-    PUMP_EVT_TOTALIZER  /* Новое событие - данные тоталайзера */
+    PUMP_EVT_TOTALIZER, /* Новое событие - данные тоталайзера */
+    PUMP_EVT_ALIVE      /* valid reply to any other command: slave is alive */
 } PumpEventType;
 
 typedef struct
@@ -52,11 +53,25 @@ typedef struct
     uint8_t error_code;  /* protocol-specific numeric error */
     uint8_t fail_count;  /* consecutive failures seen by link */
 
+    /* Reply (when type == PUMP_EVT_ALIVE): command and its decoded value
+       (realtime volume in dL for 'L', money for 'R', 0 otherwise) */
+    uint8_t cmd;
+    uint32_t value;
+
     /* Totalizer data (when type == PUMP_EVT_TOTALIZER) */
     uint8_t nozzle_idx;  /* Номер форсунки 1-6 */
     uint32_t totalizer;  /* Значение тоталайзера в сантилитрах */
 } PumpEvent;
 
+/* Cumulative link time accounting (ms since init) */
+typedef struct
+{
+    uint32_t tx_ms;      /* request on the wire */
+    uint32_t wait_ms;    /* waiting for the slave to answer */
+    uint32_t rx_ms;      /* response on the wire */
+    uint32_t exchanges;  /* finished exchanges */
+} PumpBusTime;
+
 typedef struct PumpProtoVTable
 {
     void (*task)(void *ctx);
@@ -66,6 +81,9 @@ typedef struct PumpProtoVTable
     PumpProtoResult (*request_totalizer)(void *ctx, uint8_t ctrl_addr, uint8_t slave_addr, uint8_t nozzle);
 
     bool (*pop_event)(void *ctx, PumpEvent *out);
+
+    /* Optional: link time accounting for utilisation/governor */
+    bool (*get_bus_time)(void *ctx, PumpBusTime *out);
 } PumpProtoVTable;
 
 typedef struct
@@ -103,6 +121,12 @@ static inline bool PumpProto_PopEvent(PumpProto *p, PumpEvent *out)
     return false;
 }
 
+static inline bool PumpProto_GetBusTime(const PumpProto *p, PumpBusTime *out)
+{
+    if (p && p->vt && p->vt->get_bus_time && out) return p->vt->get_bus_time(p->ctx, out);
+    return false;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -56,8 +56,9 @@ typedef struct
     uint8_t q_head;
     uint8_t q_tail;
 
-    /* In-flight request tracking */
-    uint8_t pending;
+    /* Completion slot of this layer's own 'S'/'C' requests; other
+       layers (transaction FSM) send with their own slots */
+    GKL_Completion done;
     uint8_t pending_ctrl;
     uint8_t pending_slave;
 
@@ -66,8 +67,7 @@ typedef struct
     uint8_t last_reported_failcnt;    /* No-connect log latch */
     uint8_t no_connect_latched;
 
-    /* RX trace bookkeeping (per link) */
-    uint32_t last_rx_total_frames;
+    /* RX bookkeeping (per link) */
     uint32_t last_rx_crc_errors;
 
     /* RX bytes counter at last TX (for timeout diagnostics) */
@@ -84,6 +84,12 @@ void PumpProtoGKL_Init(PumpProtoGKL *gkl, UART_HandleTypeDef *huart);
  */
 void PumpProtoGKL_SetTag(PumpProtoGKL *gkl, const char *tag);
 
+/**
+ * @brief Report a reply received in another layer's completion slot:
+ *        logged, and queued as PUMP_EVT_ALIVE (with the L/R value).
+ */
+void PumpProtoGKL_ReportReply(PumpProtoGKL *gkl, const GKL_Frame *fr);
+
 /**
  * @brief Bind implementation to generic PumpProto handle.
  */
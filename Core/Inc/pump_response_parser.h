@@ -17,11 +17,11 @@ bool PumpResp_ParseRealtimeVolume(const GKL_Frame *resp, uint8_t *nozzle, uint32
 bool PumpResp_ParseRealtimeMoney(const GKL_Frame *resp, uint8_t *nozzle, uint32_t *money);
 
 /* Parse C response - Totalizer */
-bool PumpResp_ParseTotalizer(const GKL_Frame *resp, uint8_t *nozzle, uint32_t *totalizer_dL);
+bool PumpResp_ParseTotalizer(const GKL_Frame *resp, uint8_t *nozzle, uint32_t *totalizer_cL);
 
 /* Parse T response - Transaction */
 bool PumpResp_ParseTransaction(const GKL_Frame *resp, uint8_t *nozzle, 
-                                uint32_t *volume_dL, uint32_t *money, uint16_t *price);
+                                uint32_t *volume_dL, uint32_t *money, uint32_t *price);
 
 #ifdef __cplusplus
 }
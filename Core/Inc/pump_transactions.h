@@ -10,26 +10,28 @@ extern "C" {
 #include <stdbool.h>
 #include "gkl_link.h"
 
-/* Transaction commands - Direct GKL access */
+/* Transaction commands - Direct GKL access. The reply (or the failure)
+   is delivered to the caller's completion slot *done. Presets fail for a
+   price above FIXDEC_BCD4_MAX or an amount above FIXDEC_BCD8_MAX. */
 bool PumpTrans_PresetVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, 
-                            uint8_t nozzle, uint32_t volume_dL, uint16_t price);
+                            uint8_t nozzle, uint32_t volume_dL, uint32_t price, GKL_Completion *done);
 
 bool PumpTrans_PresetMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave,
-                           uint8_t nozzle, uint32_t money, uint16_t price);
+                           uint8_t nozzle, uint32_t money, uint32_t price, GKL_Completion *done);
 
-bool PumpTrans_Stop(GKL_Link *gkl, uint8_t ctrl, uint8_t slave);
+bool PumpTrans_Stop(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done);
 
-bool PumpTrans_Resume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave);
+bool PumpTrans_Resume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done);
 
-bool PumpTrans_End(GKL_Link *gkl, uint8_t ctrl, uint8_t slave);
+bool PumpTrans_End(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done);
 
-bool PumpTrans_PollRealtimeVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle);
+bool PumpTrans_PollRealtimeVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done);
 
-bool PumpTrans_PollRealtimeMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle);
+bool PumpTrans_PollRealtimeMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done);
 
-bool PumpTrans_ReadTotalizer(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle);
+bool PumpTrans_ReadTotalizer(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done);
 
-bool PumpTrans_ReadTransaction(GKL_Link *gkl, uint8_t ctrl, uint8_t slave);
+bool PumpTrans_ReadTransaction(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done);
 
 #ifdef __cplusplus
 }
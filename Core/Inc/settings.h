@@ -10,8 +10,8 @@
   *  - EEPROM write is asynchronous (state machine) to avoid long blocking.
   *
   * Notes:
-  *  - SLOT_SIZE is 128 bytes -> fits even into 24C02 (256B) as 2 slots.
-  *  - If you use bigger EEPROM - it still works.
+  *  - SLOT_SIZE is 256 bytes (v2) -> needs at least a 24C04 for 2 slots.
+  *  - v1 records (128-byte slots) are still read and migrated on next save.
   ******************************************************************************
   */
 /* USER CODE END Header */
@@ -48,14 +48,31 @@ extern "C" {
 
 /* ========== Record format ========== */
 #define SETTINGS_MAGIC                   (0x53455431u) /* 'SET1' */
-#define SETTINGS_VERSION                 (1u)
+#define SETTINGS_VERSION                 (2u)          /* v2: links, nozzle counts */
+#define SETTINGS_VERSION_V1              (1u)          /* still accepted on load */
 
-#define SETTINGS_SLOT_SIZE               (128u)
+#define SETTINGS_SLOT_SIZE               (256u)
 #define SETTINGS_SLOT0_ADDR              (0x0000u)
-#define SETTINGS_SLOT1_ADDR              (0x0080u)
+#define SETTINGS_SLOT1_ADDR              (0x0100u)
 
-/* Max pump settings stored (matches PumpMgr capacity) */
+/* v1 layout (128-byte slots at 0x0000/0x0080), read once for migration */
+#define SETTINGS_V1_SLOT_SIZE            (128u)
+#define SETTINGS_V1_SLOT1_ADDR           (0x0080u)
+
+/* Payload: count bytes + one record per pump */
+#define SETTINGS_PAYLOAD_HDR             (2u)
+#define SETTINGS_PUMP_REC_SIZE           (6u)
+
+/* Max pump settings stored: PumpMgr capacity, but no more than one slot
+   payload holds */
+#define SETTINGS_SLOT_MAX_PUMPS          ((SETTINGS_SLOT_SIZE - 16u - SETTINGS_PAYLOAD_HDR) / SETTINGS_PUMP_REC_SIZE)
+#if (PUMP_MGR_MAX_PUMPS < SETTINGS_SLOT_MAX_PUMPS)
 #define SETTINGS_MAX_PUMPS               (PUMP_MGR_MAX_PUMPS)
+#else
+#define SETTINGS_MAX_PUMPS               (SETTINGS_SLOT_MAX_PUMPS)
+#endif
+
+#define SETTINGS_MAX_LINKS               (PUMP_MGR_MAX_LINKS)
 
 typedef enum
 {
@@ -67,14 +84,17 @@ typedef enum
 
 typedef struct
 {
+    uint8_t  link;          /* UART link index (0..link_count-1) */
     uint8_t  ctrl_addr;
     uint8_t  slave_addr;
-    uint16_t price;      /* 0..9999 (decimal), UI uses 4 digits */
+    uint8_t  nozzle_count;  /* 1..PUMP_MGR_MAX_NOZZLES */
+    uint16_t price;         /* 0..9999 (decimal), UI uses 4 digits */
 } SettingsPump;
 
 typedef struct
 {
     uint8_t pump_count; /* how many entries are valid in pump[] */
+    uint8_t link_count; /* UART links in use */
     SettingsPump pump[SETTINGS_MAX_PUMPS];
 } SettingsData;
 
@@ -1,4 +1,4 @@
-/* transaction_fsm.h - Transaction State Machine */
+/* transaction_fsm.h - Transaction State Machine (table-driven, event input) */
 #ifndef TRANSACTION_FSM_H
 #define TRANSACTION_FSM_H
 
@@ -6,6 +6,85 @@
 #include <stdbool.h>
 #include "pump_mgr.h"
 #include "pump_proto_gkl.h"
+#include "trx_metrics.h"
+
+/* Average realtime volume poll interval while dispensing: the adaptive
+   interval may go below it only by spending time banked by slower polls */
+#ifndef TRX_FSM_RT_POLL_MS
+#define TRX_FSM_RT_POLL_MS      (500u)
+#endif
+
+/* Adaptive 'L' poll interval bounds (half the predicted time to preset) */
+#ifndef TRX_FSM_RT_POLL_MIN_MS
+#define TRX_FSM_RT_POLL_MIN_MS  (150u)
+#endif
+#ifndef TRX_FSM_RT_POLL_MAX_MS
+#define TRX_FSM_RT_POLL_MAX_MS  (1000u)
+#endif
+
+/* Most poll time that can be saved up for the end of a sale */
+#ifndef TRX_FSM_RT_BANK_MS
+#define TRX_FSM_RT_BANK_MS      (3000u)
+#endif
+
+/* Flow-rate EWMA weight: new = old + (sample - old) / 2^shift */
+#ifndef TRX_FSM_FLOW_SHIFT
+#define TRX_FSM_FLOW_SHIFT      (2u)
+#endif
+
+/* Realtime poll plan, one step per poll tick, repeated:
+   'L' volume, 'R' money, 'S' pull in the manager's status poll.
+   R and S steps are skipped while the link is above its utilisation
+   target; R is also skipped once money derived from volume x price
+   has matched the pump's own figure. */
+#ifndef TRX_FSM_POLL_PLAN
+#define TRX_FSM_POLL_PLAN       "LLRS"
+#endif
+
+/* Consecutive R replies matching volume x price before R polls stop */
+#ifndef TRX_FSM_MONEY_AGREE
+#define TRX_FSM_MONEY_AGREE     (2u)
+#endif
+
+/* Pump must arm within this time after a preset, else the sale is dropped */
+#ifndef TRX_FSM_PRESET_TIMEOUT_MS
+#define TRX_FSM_PRESET_TIMEOUT_MS   (10000u)
+#endif
+
+/* Nozzle must be lifted within this time once armed, else the preset is
+   withdrawn at the pump */
+#ifndef TRX_FSM_ARMED_TIMEOUT_MS
+#define TRX_FSM_ARMED_TIMEOUT_MS    (120000u)
+#endif
+
+/* 'N' is repeated at this interval while the pump stays at S9 */
+#ifndef TRX_FSM_CLOSE_RETRY_MS
+#define TRX_FSM_CLOSE_RETRY_MS  (1000u)
+#endif
+
+/* After S8: delay before the pump's own sale record ('T') is read, then
+   the retry interval and attempts for 'T' and the totalizer ('C'). The
+   reads are given up once the nozzle is back, so 'N' is never held up. */
+#ifndef TRX_FSM_FINAL_DELAY_MS
+#define TRX_FSM_FINAL_DELAY_MS  (50u)
+#endif
+#ifndef TRX_FSM_FINAL_RETRY_MS
+#define TRX_FSM_FINAL_RETRY_MS  (250u)
+#endif
+#ifndef TRX_FSM_FINAL_TRIES
+#define TRX_FSM_FINAL_TRIES     (3u)
+#endif
+
+/* Display extrapolation: the flow rate is projected at most this far past
+   the last 'L' sample (beyond it the flow has likely stopped) */
+#ifndef TRX_FSM_DISPLAY_HORIZON_MS
+#define TRX_FSM_DISPLAY_HORIZON_MS  (1000u)
+#endif
+
+/* Retry interval for actions deferred because the link was busy */
+#ifndef TRX_FSM_RETRY_MS
+#define TRX_FSM_RETRY_MS        (20u)
+#endif
 
 typedef enum {
     TRX_IDLE = 0,
@@ -14,26 +93,157 @@ typedef enum {
     TRX_DISPENSING,
     TRX_PAUSED,
     TRX_COMPLETE,
-    TRX_CLOSING
+    TRX_CLOSING,
+    TRX_STATE_COUNT
 } TrxState;
 
+/* Typed inputs of the machine */
+typedef enum {
+    TRX_EV_STATUS = 0,      /* pump status changed (PumpMgr notification) */
+    TRX_EV_REPLY,           /* reply to our command (L/R/V/M/...) arrived */
+    TRX_EV_TIMEOUT,         /* per-state timer expired */
+    TRX_EV_START_VOLUME,    /* user commands */
+    TRX_EV_START_MONEY,
+    TRX_EV_PAUSE,
+    TRX_EV_RESUME,
+    TRX_EV_CANCEL
+} TrxEventType;
+
+typedef struct {
+    TrxEventType type;
+    uint8_t  status;        /* STATUS */
+    uint8_t  cmd;           /* REPLY */
+    uint8_t  nozzle;        /* REPLY 'C' */
+    uint32_t value;         /* REPLY value (T: volume, C: totalizer cL), START_* amount */
+    uint32_t money;         /* REPLY 'T' */
+    uint32_t price;         /* REPLY 'T' */
+} TrxEvent;
+
+/* TrxRecord.recon: how the final sale figures were reconciled */
+#define TRX_RECON_FROM_T        (0x01u)     /* volume/money from the pump's 'T' record */
+#define TRX_RECON_RT_DIFF       (0x02u)     /* last realtime figures ran ahead of 'T' */
+#define TRX_RECON_TOT_OK        (0x04u)     /* totalizer delta agrees with the volume */
+#define TRX_RECON_TOT_DIFF      (0x08u)     /* totalizer delta disagrees */
+
+/* Journal records: every state change and every finished sale */
+typedef enum {
+    TRX_REC_TRANSITION = 1,
+    TRX_REC_SALE,
+    TRX_REC_UPLOAD_ACK      /* host upload cursor (sale_id), not from the FSM */
+} TrxRecordType;
+
+typedef struct {
+    uint8_t  type;          /* TrxRecordType */
+    uint8_t  pump_id;
+    uint8_t  from;          /* TrxState before and after */
+    uint8_t  to;
+    uint8_t  pump_status;
+    bool     preset_money;  /* preset is money, else volume in dL */
+    uint32_t price;
+    uint32_t preset;
+    uint32_t volume_dL;
+    uint32_t money;
+    uint32_t sale_id;       /* assigned by the sales store, 0 from the FSM */
+    uint8_t  recon;         /* SALE: TRX_RECON_* */
+    bool     tot_after_valid;   /* SALE: totalizer read after the sale */
+    uint32_t tot_after_cL;
+} TrxRecord;
+
+typedef void (*TrxRecordFn)(void *ctx, const TrxRecord *rec);
+
 typedef struct {
     uint8_t pump_id;
     PumpMgr *mgr;
     PumpProtoGKL *gkl;
-    
+
     TrxState state;
     uint32_t preset_volume_dL;
     uint32_t preset_money;
+    bool preset_is_money;
+    bool sale_open;             /* a preset went out for this sale: close it with a SALE record */
+    uint32_t withdraw_ms;       /* 'N' sent to take back an unused preset */
     uint32_t rt_volume_dL;
     uint32_t rt_money;
-    uint32_t totalizer_dL;
-    uint32_t last_poll_ms;
-    
+
+    /* Flow tracking while dispensing */
+    uint32_t target_dL;         /* preset as volume (0 = unknown) */
+    uint32_t flow_mdL_s;        /* EWMA flow rate, 1/1000 dL per second (0 = no estimate) */
+    uint32_t last_sample_ms;    /* previous 'L' sample */
+    uint32_t last_sample_dL;
+    bool     have_sample;
+    uint32_t last_rt_poll_ms;
+    uint32_t rt_bank_ms;        /* poll time saved for a faster end phase */
+    uint32_t disp_mdL;          /* last extrapolated display volume (never shown lower) */
+
+    /* Realtime poll plan and local money derivation */
+    const char *poll_plan;      /* TRX_FSM_POLL_PLAN unless set */
+    uint8_t  plan_pos;
+    uint32_t sale_price;        /* price the preset was sent with */
+    uint8_t  money_agree;       /* consecutive matching R replies */
+    bool     money_mismatch;    /* pump money differs: use R replies only */
+
+    /* Final figures read after S8, reconciled when the sale closes */
+    bool     trx_valid;         /* 'T' reply received */
+    uint32_t trx_volume_dL;
+    uint32_t trx_money;
+    uint32_t trx_price;
+    uint8_t  t_tries;
+    uint8_t  c_tries;
+    bool     tot_before_valid;  /* nozzle 1 totalizer at the preset (manager cache) */
+    uint32_t tot_before_cL;
+    bool     tot_after_valid;   /* read in COMPLETE/CLOSING */
+    uint32_t tot_after_cL;
+    uint32_t end_ms;            /* S8 seen: cache readings from then on count as "after" */
+    uint8_t  recon;             /* TRX_RECON_* of the closing sale */
+
+    /* Preset entered while the previous sale closes (one deep), sent as
+       soon as the FSM is back in IDLE */
+    bool     next_valid;
+    uint8_t  next_type;         /* TRX_EV_START_VOLUME / TRX_EV_START_MONEY */
+    uint32_t next_value;
+
+    /* Last pump status seen (from STATUS events) */
+    uint8_t pump_status;
+
+    /* Per-state timer (0 = not armed) */
+    bool timer_armed;
+    uint32_t timer_deadline_ms;
+
+    /* STATUS transition blocked by a busy link: retried from TrxFSM_Task */
+    bool deferred;
+
+    uint8_t sub_handle;
+
+    /* Replies to this FSM's requests (nobody else reads them) */
+    GKL_Completion done;
+
+    /* Phase timing of the current sale and histograms of past ones */
+    TrxMetrics metrics;
+
+    /* Record sink (journal), NULL = none */
+    TrxRecordFn record_fn;
+    void *record_ctx;
+
 } TransactionFSM;
 
-void TrxFSM_Init(TransactionFSM *fsm, uint8_t pump_id, PumpMgr *mgr, PumpProtoGKL *gkl);
+/**
+ * @brief Reset the FSM and subscribe it to its pump's changes.
+ * @return false if the manager had no subscription slot left: the FSM
+ *         would never see a status change.
+ */
+bool TrxFSM_Init(TransactionFSM *fsm, uint8_t pump_id, PumpMgr *mgr, PumpProtoGKL *gkl);
+
+/**
+ * @brief Feed one event through the transition table.
+ * @return true if a transition (or self-transition action) was taken.
+ */
+bool TrxFSM_Dispatch(TransactionFSM *fsm, const TrxEvent *ev);
+
+/* Own replies, timers and deferred retries; costs nothing while idle */
 void TrxFSM_Task(TransactionFSM *fsm);
+
+/* Start a sale; in COMPLETE/CLOSING the preset is queued for the next one
+   (a later preset replaces it, Cancel drops it before the current sale) */
 bool TrxFSM_StartVolume(TransactionFSM *fsm, uint32_t volume_dL);
 bool TrxFSM_StartMoney(TransactionFSM *fsm, uint32_t money);
 bool TrxFSM_Pause(TransactionFSM *fsm);
@@ -43,4 +253,26 @@ TrxState TrxFSM_GetState(TransactionFSM *fsm);
 uint32_t TrxFSM_GetRealtimeVolume(TransactionFSM *fsm);
 uint32_t TrxFSM_GetRealtimeMoney(TransactionFSM *fsm);
 
+/* Display-only estimates between 'L' polls while dispensing: the last
+   sample projected by the flow rate, never below the sample (or the last
+   estimate) and never past the preset. Not for the sale record; outside
+   DISPENSING they equal the realtime values above. */
+uint32_t TrxFSM_GetDisplayVolume(TransactionFSM *fsm);
+uint32_t TrxFSM_GetDisplayMoney(TransactionFSM *fsm);
+
+/* Queued preset for the next sale: false if none */
+bool TrxFSM_GetQueuedPreset(const TransactionFSM *fsm, bool *is_money, uint32_t *value);
+
+/* Sink for transition and sale records (e.g. the EEPROM journal) */
+void TrxFSM_SetRecorder(TransactionFSM *fsm, TrxRecordFn fn, void *ctx);
+
+/* Poll plan for following sales (string of 'L'/'R'/'S', NULL = default) */
+void TrxFSM_SetPollPlan(TransactionFSM *fsm, const char *plan);
+
+/* Estimated flow rate in 1/1000 dL per second (0 = not dispensing / no estimate) */
+uint32_t TrxFSM_GetFlowRate(TransactionFSM *fsm);
+
+/* Sale phase timing histograms of this pump */
+const TrxMetrics *TrxFSM_GetMetrics(const TransactionFSM *fsm);
+
 #endif
@@ -0,0 +1,142 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_journal.h
+  * @brief   Append-only transaction journal in the settings EEPROM.
+  *
+  * Goals:
+  *  - Every finished sale, the host's upload cursor and the transitions
+  *    that matter after a power loss (preset sent, flow started, preset
+  *    withdrawn) survive it: about three records per sale, so the ring
+  *    holds ~TRX_JOURNAL_CAPACITY / 3 unacknowledged sales.
+  *  - Fixed 32-byte records with sequence number and CRC32.
+  *  - Circular log: each slot is written once per lap (wear levelling).
+  *  - Writes are queued in RAM and go out with HAL_I2C_Mem_Write_IT,
+  *    one record per pass, never while a settings save owns the EEPROM.
+  *  - Boot finds the head with a binary search (log2(capacity) reads).
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#ifndef TRX_JOURNAL_H
+#define TRX_JOURNAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "settings.h"
+#include "transaction_fsm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ========== EEPROM region (after the two settings slots) ========== */
+#ifndef TRX_JOURNAL_BASE_ADDR
+#define TRX_JOURNAL_BASE_ADDR           (0x0200u)
+#endif
+
+/* End of the region (exclusive): 0x8000 = AT24C256 */
+#ifndef TRX_JOURNAL_END_ADDR
+#define TRX_JOURNAL_END_ADDR            (0x8000u)
+#endif
+
+/* Record size: divides the page size, so a record never crosses a page */
+#define TRX_JOURNAL_REC_SIZE            (32u)
+#define TRX_JOURNAL_CAPACITY            ((TRX_JOURNAL_END_ADDR - TRX_JOURNAL_BASE_ADDR) / TRX_JOURNAL_REC_SIZE)
+
+#if ((TRX_JOURNAL_BASE_ADDR % TRX_JOURNAL_REC_SIZE) != 0u) || ((SETTINGS_EEPROM_PAGE_SIZE % TRX_JOURNAL_REC_SIZE) != 0u)
+#error "Journal records must not cross EEPROM pages"
+#endif
+
+/* Records waiting in RAM for the EEPROM */
+#ifndef TRX_JOURNAL_QUEUE_LEN
+#define TRX_JOURNAL_QUEUE_LEN           (16u)
+#endif
+
+/* Write attempts per record before it is dropped */
+#ifndef TRX_JOURNAL_RETRIES
+#define TRX_JOURNAL_RETRIES             (3u)
+#endif
+
+typedef struct
+{
+    uint32_t  seq;          /* assigned when written, 0 while queued */
+    uint32_t  time_ms;      /* HAL tick at append (not stored for records with a sale id) */
+    TrxRecord rec;
+} TrxJournalEntry;
+
+/* Replay visitor, oldest first; return false to stop */
+typedef bool (*TrxJournalVisitFn)(void *ctx, const TrxJournalEntry *e);
+
+typedef struct
+{
+    Settings *bus;          /* owner of the I2C handle and the EEPROM */
+
+    uint16_t head;          /* next slot to write */
+    uint32_t next_seq;
+
+    /* RAM queue (main loop only) */
+    TrxJournalEntry q[TRX_JOURNAL_QUEUE_LEN];
+    uint8_t  q_head;
+    uint8_t  q_count;
+
+    /* Write in progress (flags also touched from the I2C callbacks) */
+    volatile uint8_t wr_inflight;
+    volatile uint8_t wr_failed;
+    uint8_t  wr_wait_ready;
+    uint8_t  wr_tries;
+    uint32_t wr_ready_start_ms;
+    uint8_t  wr_buf[TRX_JOURNAL_REC_SIZE];
+
+    /* Counters */
+    uint32_t written;
+    uint32_t dropped;       /* queue full or retries exhausted */
+} TrxJournal;
+
+/**
+ * @brief Bind to the settings EEPROM (same I2C handle and device).
+ */
+void TrxJournal_Init(TrxJournal *j, Settings *bus);
+
+/**
+ * @brief Find the log head (blocking reads, startup only).
+ * @return true if the journal holds records.
+ */
+bool TrxJournal_Recover(TrxJournal *j);
+
+/**
+ * @brief Walk the newest max records, oldest first (blocking reads, startup
+ *        only). Torn or stale slots are skipped.
+ * @return number of records visited.
+ */
+uint16_t TrxJournal_Replay(TrxJournal *j, uint16_t max, TrxJournalVisitFn fn, void *ctx);
+
+/**
+ * @brief Walk back from the newest record until fn returns false or max
+ *        records were read (blocking reads, startup only); finds how much
+ *        of the tail TrxJournal_Replay() has to visit.
+ * @return number of records visited, the one fn stopped at included.
+ */
+uint16_t TrxJournal_ReplayBack(TrxJournal *j, uint16_t max, TrxJournalVisitFn fn, void *ctx);
+
+/**
+ * @brief Queue a record; never blocks. Usable as a TrxRecordFn (ctx = journal).
+ */
+void TrxJournal_Append(void *ctx, const TrxRecord *rec);
+
+/**
+ * @brief Must be called often from main loop (one record write at a time).
+ */
+void TrxJournal_Task(TrxJournal *j);
+
+uint8_t TrxJournal_Pending(const TrxJournal *j);
+
+/* Forwarded from the HAL I2C callbacks in settings.c */
+void TrxJournal_OnI2CTxCplt(I2C_HandleTypeDef *hi2c);
+void TrxJournal_OnI2CError(I2C_HandleTypeDef *hi2c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRX_JOURNAL_H */
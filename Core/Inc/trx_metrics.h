@@ -0,0 +1,100 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_metrics.h
+  * @brief   Per-pump sale timing: phase timestamps and interval histograms.
+  *
+  * Goals:
+  *  - The FSM stamps each phase of a sale once (first time it is reached).
+  *  - When the sale closes, every interval whose two ends were stamped is
+  *    added to a fixed log2 histogram (no allocation, no floating point).
+  *  - Average flow rate of the sale is kept as a histogram too.
+  *  - Controller-side latency shows up on its own, e.g. S9 -> 'N' sent.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#ifndef TRX_METRICS_H
+#define TRX_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Histogram buckets: 0 holds 0..1, bucket k holds 2^k .. 2^(k+1)-1,
+   the last one everything above */
+#ifndef TRX_METRICS_BUCKETS
+#define TRX_METRICS_BUCKETS     (16u)
+#endif
+
+/* Sale phases, in the order they normally happen */
+typedef enum
+{
+    TRX_PH_PRESET = 0,      /* preset accepted by the link */
+    TRX_PH_ARMED,           /* S3 */
+    TRX_PH_FLOW,            /* S4/S6 */
+    TRX_PH_END,             /* S8 */
+    TRX_PH_NOZZLE_BACK,     /* S9 */
+    TRX_PH_END_SENT,        /* 'N' on the wire */
+    TRX_PH_CLOSED,          /* S1 */
+    TRX_PH_COUNT
+} TrxPhase;
+
+/* Measured values: intervals in ms, flow rate in dL/min */
+typedef enum
+{
+    TRX_MET_AUTHORISE = 0,  /* preset -> S3 */
+    TRX_MET_LIFT,           /* S3 -> flow (customer) */
+    TRX_MET_FILL,           /* flow -> S8 */
+    TRX_MET_HANG_UP,        /* S8 -> S9 (customer) */
+    TRX_MET_END_LATENCY,    /* S9 -> 'N' sent (controller) */
+    TRX_MET_CLOSE,          /* 'N' sent -> S1 (pump) */
+    TRX_MET_SALE,           /* preset -> S1 */
+    TRX_MET_FLOW_RATE,      /* average over the fill, dL/min */
+    TRX_MET_COUNT
+} TrxMetric;
+
+typedef struct
+{
+    uint16_t bucket[TRX_METRICS_BUCKETS];   /* saturating counts */
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+} TrxMetricHist;
+
+typedef struct
+{
+    uint32_t stamp_ms[TRX_PH_COUNT];
+    uint8_t  stamped;                       /* bit per TrxPhase */
+
+    TrxMetricHist hist[TRX_MET_COUNT];
+} TrxMetrics;
+
+void TrxMetrics_Init(TrxMetrics *m);
+
+/**
+ * @brief Stamp a phase of the current sale (only the first time it is reached).
+ */
+void TrxMetrics_Stamp(TrxMetrics *m, TrxPhase phase, uint32_t now_ms);
+
+/**
+ * @brief Sale closed: add its intervals and flow rate, start over.
+ */
+void TrxMetrics_Close(TrxMetrics *m, uint32_t volume_dL);
+
+/**
+ * @brief Drop the stamps of a sale that did not complete.
+ */
+void TrxMetrics_Reset(TrxMetrics *m);
+
+/* Short name of a metric for host output */
+const char *TrxMetrics_Name(TrxMetric met);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRX_METRICS_H */
@@ -0,0 +1,181 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_store.h
+  * @brief   In-RAM sales history with per-pump and time-range queries.
+  *
+  * Goals:
+  *  - Fixed-size records in a ring placed in D2 SRAM (NOLOAD, cleared at init).
+  *  - Sales are appended in end-time order, so the ring itself is the time
+  *    index: a range starts with a binary search on end_ms. Ticks wrap, so
+  *    time queries only see sales within TRX_STORE_TIME_SPAN_MS of the
+  *    newest one; older ones (and restored ones, which have no tick) are
+  *    still reachable by seq.
+  *  - Per-pump index: ring of sale seq numbers per pump, also time ordered,
+  *    so a pump range is a binary search too.
+  *  - Cursor queries (seek + next) so long answers can be paged out over CDC.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#ifndef TRX_STORE_H
+#define TRX_STORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "transaction_fsm.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Sales kept (all pumps) */
+#ifndef TRX_STORE_CAPACITY
+#define TRX_STORE_CAPACITY          (4096u)
+#endif
+
+/* Every pump has its own index */
+#define TRX_STORE_INDEX_PUMPS       (PUMP_MGR_MAX_PUMPS)
+
+/* Index entries, all pumps together: 64 KB, beside the 176 KB sale ring in
+   the 288 KB of D2 SRAM */
+#ifndef TRX_STORE_INDEX_ENTRIES
+#define TRX_STORE_INDEX_ENTRIES     (16384u)
+#endif
+
+/* Index depth per pump (512 with 32 pumps); older sales of a pump are
+   still in the ring but only found through an all-pumps query */
+#ifndef TRX_STORE_INDEX_DEPTH
+#define TRX_STORE_INDEX_DEPTH       (TRX_STORE_INDEX_ENTRIES / TRX_STORE_INDEX_PUMPS)
+#endif
+#if TRX_STORE_INDEX_DEPTH == 0u
+#error "TRX_STORE_INDEX_DEPTH must be at least 1"
+#endif
+
+/* Widest end_ms span time queries cover; the wrap-around tick compare is
+   only valid within 2^31 ms (~24.8 days) */
+#ifndef TRX_STORE_TIME_SPAN_MS
+#define TRX_STORE_TIME_SPAN_MS      (0x7FFFFFFFu)
+#endif
+#if TRX_STORE_TIME_SPAN_MS > 0x7FFFFFFFu
+#error "TRX_STORE_TIME_SPAN_MS must stay below 2^31 ms"
+#endif
+
+/* Linker section for the store: D2 SRAM, not loaded, not zeroed */
+#ifndef TRX_STORE_SECTION
+#define TRX_STORE_SECTION           __attribute__((section(".ram_d2"), aligned(32)))
+#endif
+
+/* TrxSale.flags */
+#define TRX_SALE_F_PRESET_MONEY     (0x01u)
+#define TRX_SALE_F_TOT_BEFORE       (0x02u)     /* tot_before_cL is valid */
+#define TRX_SALE_F_TOT_AFTER        (0x04u)     /* tot_after_cL is valid */
+#define TRX_SALE_F_RESTORED         (0x08u)     /* from the journal: no start/end tick */
+
+typedef struct
+{
+    uint32_t seq;           /* 1.. (0 = empty) */
+    uint8_t  pump_id;
+    uint8_t  nozzle;
+    uint8_t  flags;         /* TRX_SALE_F_* */
+    uint8_t  recon;         /* TRX_RECON_* */
+    uint32_t volume_dL;
+    uint32_t money;
+    uint32_t preset;        /* volume in dL or money, see flags */
+    uint32_t price;
+    uint32_t start_ms;
+    uint32_t end_ms;
+    uint32_t tot_before_cL;
+    uint32_t tot_after_cL;
+} TrxSale;
+
+/* Sale in progress: what is known before the FSM reports the result */
+typedef struct
+{
+    bool     open;
+    uint8_t  nozzle;
+    bool     tot_valid;
+    uint32_t start_ms;
+    uint32_t tot_before_cL;
+} TrxStoreOpen;
+
+typedef struct
+{
+    TrxSale  sale[TRX_STORE_CAPACITY];      /* sale seq s lives at s % CAPACITY */
+    uint32_t base_seq;                      /* first seq of this boot */
+    uint32_t next_seq;
+    uint32_t time_seq;                      /* oldest seq time queries see */
+
+    uint32_t pump_seq[TRX_STORE_INDEX_PUMPS][TRX_STORE_INDEX_DEPTH];
+    uint32_t pump_next[TRX_STORE_INDEX_PUMPS];  /* sales ever indexed per pump */
+
+    TrxStoreOpen open[PUMP_MGR_MAX_PUMPS];
+} TrxStore;
+
+typedef struct
+{
+    uint8_t  pump_id;       /* 0 = all pumps */
+    uint8_t  nozzle;        /* 0 = all nozzles */
+    uint32_t from_ms;       /* end_ms range, inclusive */
+    uint32_t to_ms;
+    uint32_t pos;           /* next sale seq, or pump sale number when indexed */
+    uint32_t end;           /* one past the last position */
+} TrxStoreCursor;
+
+void TrxStore_Init(TrxStore *st);
+
+/**
+ * @brief Remember start time and totalizer for a pump's sale in progress.
+ */
+void TrxStore_OpenSale(TrxStore *st, uint8_t pump_id, uint8_t nozzle,
+                       uint32_t start_ms, bool tot_valid, uint32_t tot_before_cL);
+
+/**
+ * @brief Store a finished sale (FSM TRX_REC_SALE record).
+ * @return seq of the stored sale, 0 if not stored.
+ */
+uint32_t TrxStore_CloseSale(TrxStore *st, const TrxRecord *rec, uint32_t end_ms);
+
+/**
+ * @brief Continue sale numbering after a reboot (empty store only).
+ */
+void TrxStore_SetNextSeq(TrxStore *st, uint32_t seq);
+
+/**
+ * @brief Re-insert a sale recovered from the journal under its old seq
+ *        (rec->sale_id, ascending); no ticks or totalizers are known, so
+ *        it is flagged TRX_SALE_F_RESTORED and kept out of time queries.
+ * @return false if out of order.
+ */
+bool TrxStore_Restore(TrxStore *st, const TrxRecord *rec);
+
+/**
+ * @brief Fill in the totalizer after the newest sale of a pump/nozzle if still missing
+ *        (ignored while the pump has a sale open: the reading is that sale's).
+ */
+void TrxStore_SetTotalizerAfter(TrxStore *st, uint8_t pump_id, uint8_t nozzle, uint32_t tot_cL);
+
+/* Sales are numbered from base_seq; numbers lost before a reboot leave holes */
+bool TrxStore_Get(const TrxStore *st, uint32_t seq, TrxSale *out);
+uint32_t TrxStore_Count(const TrxStore *st);
+uint32_t TrxStore_OldestSeq(const TrxStore *st);
+
+/**
+ * @brief Position a cursor on the first sale with end_ms >= from_ms (O(log n)).
+ *        from_ms/to_ms are ticks compared with wrap-around against sales
+ *        within TRX_STORE_TIME_SPAN_MS of the newest one.
+ */
+void TrxStore_Seek(const TrxStore *st, TrxStoreCursor *c, uint8_t pump_id, uint8_t nozzle,
+                   uint32_t from_ms, uint32_t to_ms);
+
+/**
+ * @brief Next sale in range (nozzle filter applied).
+ * @return false when the range is exhausted.
+ */
+bool TrxStore_Next(const TrxStore *st, TrxStoreCursor *c, TrxSale *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRX_STORE_H */
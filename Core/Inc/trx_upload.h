@@ -0,0 +1,88 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_upload.h
+  * @brief   Store-and-forward upload of finished sales to the host over CDC.
+  *
+  * The host pulls batches ("UPL") and acknowledges the last sale it stored
+  * ("ACK <seq>"). The ACK cursor is written to the transaction journal, so
+  * after a reboot or a reconnect the upload resumes after it: nothing acked
+  * is sent again, nothing unacked is skipped (gaps in seq show lost sales).
+  *
+  * Batch frame (binary, little-endian):
+  *  [0]  0x55 0xAA 'U'
+  *  [3]  u8  count (0 = nothing after the cursor)
+  *  [4]  u32 ack cursor the batch follows
+  *  [8]  count x 32-byte sale records
+  *  [..] u32 crc32 of bytes [2 .. end of records]
+  *
+  * Sale record: u32 seq, u8 pump, u8 nozzle, u8 flags, u8 recon,
+  *              u32 volume_dL, u32 money, u32 preset, u32 price,
+  *              u32 tot_before_cL, u32 tot_after_cL
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#ifndef TRX_UPLOAD_H
+#define TRX_UPLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "trx_store.h"
+#include "trx_journal.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Sales per batch */
+#ifndef TRX_UPLOAD_BATCH
+#define TRX_UPLOAD_BATCH        (32u)
+#endif
+
+#define TRX_UPLOAD_REC_SIZE     (32u)
+#define TRX_UPLOAD_HDR_SIZE     (8u)
+#define TRX_UPLOAD_FRAME_MAX    (TRX_UPLOAD_HDR_SIZE + TRX_UPLOAD_BATCH * TRX_UPLOAD_REC_SIZE + 4u)
+
+typedef struct
+{
+    TrxStore   *store;
+    TrxJournal *journal;
+
+    uint32_t acked;         /* host has every sale up to this seq */
+    uint32_t sent;          /* last seq put into a batch */
+
+    /* Batch waiting for room in the CDC logger */
+    uint8_t  frame[TRX_UPLOAD_FRAME_MAX];
+    uint16_t frame_len;
+} TrxUpload;
+
+/**
+ * @param acked  cursor recovered from the journal (0 = none)
+ */
+void TrxUpload_Init(TrxUpload *u, TrxStore *store, TrxJournal *journal, uint32_t acked);
+
+/**
+ * @brief Build the next batch; rewind = start again after the ACK cursor
+ *        (host reconnected and lost what was in flight).
+ * @return false if a batch is still waiting to go out.
+ */
+bool TrxUpload_Request(TrxUpload *u, bool rewind);
+
+/**
+ * @brief Host stored everything up to seq; cursor is journalled.
+ * @return false if seq was never sent or is behind the cursor.
+ */
+bool TrxUpload_Ack(TrxUpload *u, uint32_t seq);
+
+/* Sales not yet acknowledged */
+uint32_t TrxUpload_Backlog(const TrxUpload *u);
+
+/* Pushes a built batch once the CDC logger has room */
+void TrxUpload_Task(TrxUpload *u);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRX_UPLOAD_H */
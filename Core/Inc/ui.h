@@ -16,15 +16,16 @@ typedef enum {
 } UI_Screen;
 
 typedef struct {
-    /* FSM instances */
-    TransactionFSM *trk1_fsm;
-    TransactionFSM *trk2_fsm;
+    /* FSM instances, one per pump in display order */
+    TransactionFSM *const *fsm;
+    uint8_t fsm_count;
     
     Settings *settings;
     
     /* UI state */
     UI_Screen screen;
-    uint8_t active_pump_id;
+    uint8_t active_idx;         /* index into fsm[] */
+    uint8_t active_pump_id;     /* fsm[active_idx]->pump_id */
     
     /* Input */
     char edit_buf[8];
@@ -33,14 +34,19 @@ typedef struct {
     /* Mode selection: 0=Volume, 1=Money, 2=Full */
     uint8_t selected_mode;
     
+    /* Totalizer screen: page of the pump/nozzle list */
+    uint8_t tot_page;
+    
     /* Display */
     uint32_t last_render_ms;
     uint32_t blink_timer_ms;
     bool blink_state;
+    bool dirty;             /* pump state changed since last render */
     
 } UI_Context;
 
-void UI_Init(UI_Context *ui, TransactionFSM *trk1_fsm, TransactionFSM *trk2_fsm, Settings *settings);
+/* false if the redraw subscription could not be taken */
+bool UI_Init(UI_Context *ui, TransactionFSM *const *fsm, uint8_t fsm_count, Settings *settings);
 void UI_Task(UI_Context *ui, char key);
 
 #endif
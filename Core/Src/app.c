@@ -2,71 +2,303 @@
 #include "app.h"
 #include "keyboard.h"
 #include "cdc_logger.h"
+#include "host_cmd.h"
 #include <stdio.h>
 #include <string.h>
 
 static AppContext s_app;
+static TrxStore s_store TRX_STORE_SECTION;
 
-void APP_Init(UART_HandleTypeDef *huart_trk1, UART_HandleTypeDef *huart_trk2, I2C_HandleTypeDef *hi2c)
+/* Committed price changes (e.g. a price update job) go to EEPROM */
+static void app_on_price_change(void *ctx, const PumpMgrNotify *n)
+{
+    (void)ctx;
+    (void)n;
+    s_app.settings_dirty = true;
+}
+
+/* FSM records: finished sales go to the history and the journal. Of the
+   state changes only those a power cut must leave a trace of are
+   journalled: preset sent, flow started, and the return to idle of a sale
+   that ended without one (preset withdrawn). The rest (armed, paused,
+   complete, closing) would use the ring up ~3 times faster. */
+static void app_on_trx_record(void *ctx, const TrxRecord *rec)
+{
+    (void)ctx;
+    if (rec->pump_id == 0u || rec->pump_id > SETTINGS_MAX_PUMPS) return;
+    bool *open = &s_app.journal_open[rec->pump_id - 1u];
+
+    if (rec->type == TRX_REC_TRANSITION) {
+        if (rec->from == TRX_IDLE && rec->to == TRX_PRESET_SENT) {
+            PumpTotalizer tot;
+            bool tot_ok = PumpMgr_GetTotalizer(&s_app.mgr, rec->pump_id, 1u, &tot) && tot.valid;
+            TrxStore_OpenSale(s_app.store, rec->pump_id, 1u, HAL_GetTick(), tot_ok, tot_ok ? tot.value : 0u);
+            TrxJournal_Append(&s_app.journal, rec);
+            *open = true;
+        } else if (rec->from == TRX_ARMED && rec->to == TRX_DISPENSING) {
+            TrxJournal_Append(&s_app.journal, rec);
+        } else if (rec->to == TRX_IDLE && *open) {
+            TrxJournal_Append(&s_app.journal, rec);
+            *open = false;
+        }
+    } else if (rec->type == TRX_REC_SALE) {
+        /* The journal keeps the store's seq, the upload cursor refers to it */
+        TrxRecord sale = *rec;
+        sale.sale_id = TrxStore_CloseSale(s_app.store, rec, HAL_GetTick());
+        TrxJournal_Append(&s_app.journal, &sale);
+        *open = false;
+        /* Totalizer after the sale arrives with the next refresh */
+        PumpMgr_RefreshTotalizers(&s_app.mgr, rec->pump_id);
+    }
+}
+
+static void app_on_totalizer(void *ctx, const PumpMgrNotify *n)
+{
+    (void)ctx;
+    TrxStore_SetTotalizerAfter(s_app.store, n->pump_id, n->nozzle_idx, n->totalizer);
+}
+
+/* Boot replay in two passes. Newest first: the newest upload cursor, the
+   newest sale, per pump whether its last record left a sale open, and where
+   the unacknowledged tail starts (the newest sale the cursor covers). Then
+   oldest first over that tail only: its sales go back into the history and
+   the upload. Acknowledged sales are not read back. */
+typedef struct {
+    uint32_t acked;         /* newest upload cursor */
+    uint32_t max_sale;      /* newest sale seq */
+    uint32_t restored;
+    bool     have_ack;
+    bool     at_acked;      /* walk stopped on an acknowledged sale */
+    bool     seen[SETTINGS_MAX_PUMPS];
+} AppReplay;
+
+static bool app_on_replay_back(void *ctx, const TrxJournalEntry *e)
+{
+    AppReplay *r = (AppReplay *)ctx;
+    uint8_t id = e->rec.pump_id;
+
+    if (e->rec.type == TRX_REC_UPLOAD_ACK) {
+        if (!r->have_ack) {
+            r->acked = e->rec.sale_id;
+            r->have_ack = true;
+        }
+        return true;
+    }
+    if (id == 0u || id > SETTINGS_MAX_PUMPS) return true;
+
+    if (e->rec.type == TRX_REC_SALE) {
+        if (r->max_sale == 0u) r->max_sale = e->rec.sale_id;
+        r->seen[id - 1u] = true;
+        if (r->have_ack && e->rec.sale_id <= r->acked) {
+            r->at_acked = true;
+            return false;
+        }
+    } else if (e->rec.type == TRX_REC_TRANSITION && !r->seen[id - 1u]) {
+        r->seen[id - 1u] = true;
+        if (e->rec.to != TRX_IDLE) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), ">>> TRK%u: sale interrupted (state %u, seq %lu)",
+                     (unsigned)id, (unsigned)e->rec.to, (unsigned long)e->seq);
+            CDC_Log(msg);
+        }
+    }
+    return true;
+}
+
+static bool app_on_replay(void *ctx, const TrxJournalEntry *e)
+{
+    AppReplay *r = (AppReplay *)ctx;
+
+    if (e->rec.type == TRX_REC_SALE &&
+        TrxStore_Restore(s_app.store, &e->rec)) r->restored++;
+    return true;
+}
+
+/* ===== Static arena: per-site objects, bump-allocated once at boot ===== */
+static uint8_t s_arena[APP_ARENA_SIZE] __attribute__((aligned(APP_ARENA_ALIGN)));
+static uint32_t s_arena_used;
+
+static void *app_alloc(uint32_t size)
+{
+    uint32_t off = (s_arena_used + (APP_ARENA_ALIGN - 1u)) & ~(APP_ARENA_ALIGN - 1u);
+    if (size > APP_ARENA_SIZE || off > (APP_ARENA_SIZE - size)) return NULL;
+
+    s_arena_used = off + size;
+    memset(&s_arena[off], 0, size);
+    return &s_arena[off];
+}
+
+/* Give back everything allocated since mark (an object whose setup failed;
+   nothing else may point into it) */
+static void app_release(uint32_t mark)
+{
+    s_arena_used = mark;
+}
+
+/* Prices used when no settings are stored yet (TRK1, TRK2) */
+static const uint16_t s_default_price[] = { 1122u, 2233u };
+
+/* Protocol instance for a link, created on first use */
+static bool app_link(uint8_t link, UART_HandleTypeDef *const *uarts, uint8_t uart_count)
+{
+    if (s_app.gkl[link] != NULL) return true;
+    if (link >= uart_count || uarts[link] == NULL) return false;
+
+    uint32_t mark = s_arena_used;
+    PumpProtoGKL *gkl = (PumpProtoGKL *)app_alloc(sizeof(PumpProtoGKL));
+    if (gkl == NULL) return false;
+
+    char tag[8];
+    snprintf(tag, sizeof(tag), "TRK%u", (unsigned)(link + 1u));
+    PumpProtoGKL_Init(gkl, uarts[link]);
+    if (gkl->link.last_error == GKL_ERR_PARAM) {
+        char msg[48];
+        snprintf(msg, sizeof(msg), ">>> Link %u: not registered (GKL_MAX_LINKS)", (unsigned)link);
+        CDC_Log(msg);
+        app_release(mark);
+        return false;
+    }
+    PumpProtoGKL_SetTag(gkl, tag);
+    PumpProtoGKL_Bind(&s_app.proto[link], gkl);
+
+    s_app.gkl[link] = gkl;
+    s_app.link_count++;
+    return true;
+}
+
+void APP_Init(UART_HandleTypeDef *const *uarts, uint8_t uart_count, I2C_HandleTypeDef *hi2c)
 {
     CDC_Log(">>> System Booting...");
     
     memset(&s_app, 0, sizeof(s_app));
+    s_arena_used = 0u;
     
-    /* Init protocol */
-    PumpProtoGKL_Init(&s_app.gkl1, huart_trk1);
-    PumpProtoGKL_SetTag(&s_app.gkl1, "TRK1");
-    PumpProtoGKL_Bind(&s_app.proto1, &s_app.gkl1);
+    s_app.store = &s_store;
+    TrxStore_Init(s_app.store);
     
-    PumpProtoGKL_Init(&s_app.gkl2, huart_trk2);
-    PumpProtoGKL_SetTag(&s_app.gkl2, "TRK2");
-    PumpProtoGKL_Bind(&s_app.proto2, &s_app.gkl2);
+    /* Load settings first: they describe links and pumps */
+    Settings_Init(&s_app.settings, hi2c);
+    bool loaded = Settings_Load(&s_app.settings);
+    CDC_Log(loaded ? ">>> Settings loaded from EEPROM" : ">>> Settings not found, using defaults");
     
-    CDC_Log(">>> GKL protocol ready");
+    /* Journal: sales and upload cursor from before the reset */
+    AppReplay replay;
+    memset(&replay, 0, sizeof(replay));
+    TrxJournal_Init(&s_app.journal, &s_app.settings);
+    if (TrxJournal_Recover(&s_app.journal)) {
+        uint16_t n = TrxJournal_ReplayBack(&s_app.journal, APP_JOURNAL_REPLAY_MAX, app_on_replay_back, &replay);
+        uint16_t tail = (uint16_t)(replay.at_acked ? n - 1u : n);
+        TrxJournal_Replay(&s_app.journal, tail, app_on_replay, &replay);
+        char msg[64];
+        snprintf(msg, sizeof(msg), ">>> Journal: next seq %lu, %u records, %lu sales restored",
+                 (unsigned long)s_app.journal.next_seq, (unsigned)n, (unsigned long)replay.restored);
+        CDC_Log(msg);
+        if (!replay.at_acked && n == APP_JOURNAL_REPLAY_MAX) {
+            CDC_Log(">>> Journal: replay capped (APP_JOURNAL_REPLAY_MAX), older sales not restored");
+        }
+    } else {
+        CDC_Log(">>> Journal empty");
+    }
     
-    /* Init pump manager */
-    PumpMgr_Init(&s_app.mgr, 250);
-    PumpMgr_Add(&s_app.mgr, 1, &s_app.proto1, 0, 1);
-    PumpMgr_Add(&s_app.mgr, 2, &s_app.proto2, 0, 2);
+    /* Sale numbering continues; sales after the cursor are uploaded again */
+    TrxStore_SetNextSeq(s_app.store, ((replay.max_sale > replay.acked) ? replay.max_sale : replay.acked) + 1u);
+    TrxUpload_Init(&s_app.upload, s_app.store, &s_app.journal, replay.acked);
+    {
+        char msg[64];
+        snprintf(msg, sizeof(msg), ">>> Upload: acked %lu, backlog %lu",
+                 (unsigned long)replay.acked, (unsigned long)TrxUpload_Backlog(&s_app.upload));
+        CDC_Log(msg);
+    }
     
-    /* Set default prices */
-    PumpDevice *d1 = PumpMgr_Get(&s_app.mgr, 1);
-    PumpDevice *d2 = PumpMgr_Get(&s_app.mgr, 2);
-    if (d1) d1->price = 1122;
-    if (d2) d2->price = 2233;
+    /* Build topology: links on demand, one manager entry and FSM per pump */
+    PumpMgr_Init(&s_app.mgr, 250);
     
-    /* Load settings */
-    Settings_Init(&s_app.settings, hi2c);
-    if (Settings_Load(&s_app.settings)) {
-        CDC_Log(">>> Settings loaded from EEPROM");
-        Settings_ApplyToPumpMgr(&s_app.settings, &s_app.mgr);
+    const SettingsData *cfg = &s_app.settings.data;
+    for (uint8_t i = 0; i < cfg->pump_count; i++) {
+        const SettingsPump *sp = &cfg->pump[i];
+        uint8_t id = (uint8_t)(i + 1u);
+        char msg[64];
         
-        d1 = PumpMgr_Get(&s_app.mgr, 1);
-        d2 = PumpMgr_Get(&s_app.mgr, 2);
-        if (d1) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), ">>> TRK1: addr=%u price=%lu",
-                    (unsigned)d1->slave_addr, (unsigned long)d1->price);
+        if (!app_link(sp->link, uarts, uart_count)) {
+            snprintf(msg, sizeof(msg), ">>> TRK%u: link %u unavailable", (unsigned)id, (unsigned)sp->link);
             CDC_Log(msg);
+            continue;
         }
-        if (d2) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), ">>> TRK2: addr=%u price=%lu",
-                    (unsigned)d2->slave_addr, (unsigned long)d2->price);
+        
+        uint32_t mark = s_arena_used;
+        TransactionFSM *fsm = (TransactionFSM *)app_alloc(sizeof(TransactionFSM));
+        if (fsm == NULL) {
+            snprintf(msg, sizeof(msg), ">>> TRK%u: arena full (%lu/%lu bytes)", (unsigned)id,
+                     (unsigned long)s_arena_used, (unsigned long)APP_ARENA_SIZE);
+            CDC_Log(msg);
+            continue;
+        }
+        if (!PumpMgr_Add(&s_app.mgr, id, &s_app.proto[sp->link], sp->ctrl_addr, sp->slave_addr)) {
+            snprintf(msg, sizeof(msg), ">>> TRK%u: not added", (unsigned)id);
+            CDC_Log(msg);
+            app_release(mark);
+            continue;
+        }
+        
+        if (!TrxFSM_Init(fsm, id, &s_app.mgr, s_app.gkl[sp->link])) {
+            snprintf(msg, sizeof(msg), ">>> TRK%u: no FSM (PUMP_MGR_MAX_SUBS)", (unsigned)id);
             CDC_Log(msg);
+            app_release(mark);
+            continue;
         }
+        TrxFSM_SetRecorder(fsm, app_on_trx_record, NULL);
+        s_app.fsm[s_app.fsm_count++] = fsm;
+    }
+    
+    CDC_Log(">>> GKL protocol ready");
+    
+    if (loaded) {
+        Settings_ApplyToPumpMgr(&s_app.settings, &s_app.mgr);
     } else {
-        CDC_Log(">>> Settings not found, using defaults");
+        for (uint8_t i = 0; i < (uint8_t)(sizeof(s_default_price) / sizeof(s_default_price[0])); i++) {
+            PumpMgr_SetPrice(&s_app.mgr, (uint8_t)(i + 1u), s_default_price[i]);
+        }
+    }
+    
+    for (uint8_t k = 0; k < s_app.fsm_count; k++) {
+        PumpSnapshot snap;
+        uint8_t id = s_app.fsm[k]->pump_id;
+        if (PumpMgr_Snapshot(&s_app.mgr, id, &snap)) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), ">>> TRK%u: addr=%u price=%lu",
+                    (unsigned)id, (unsigned)snap.slave_addr, (unsigned long)snap.price);
+            CDC_Log(msg);
+        }
     }
     
-    /* Init FSM */
-    TrxFSM_Init(&s_app.trk1_fsm, 1, &s_app.mgr, &s_app.gkl1);
-    TrxFSM_Init(&s_app.trk2_fsm, 2, &s_app.mgr, &s_app.gkl2);
+    /* Boot report: what the site configuration costs */
+    {
+        char msg[80];
+        snprintf(msg, sizeof(msg), ">>> Arena: %lu/%lu bytes, %u links x %u, %u pumps x %u",
+                 (unsigned long)s_arena_used, (unsigned long)APP_ARENA_SIZE,
+                 (unsigned)s_app.link_count, (unsigned)sizeof(PumpProtoGKL),
+                 (unsigned)s_app.fsm_count, (unsigned)sizeof(TransactionFSM));
+        CDC_Log(msg);
+        snprintf(msg, sizeof(msg), ">>> Sales store: %u sales, %lu bytes in D2",
+                 (unsigned)TRX_STORE_CAPACITY, (unsigned long)sizeof(TrxStore));
+        CDC_Log(msg);
+    }
+    
+    /* Subscribe only now, so loading settings does not trigger a save */
+    if (PumpMgr_Subscribe(&s_app.mgr, 0, PUMP_MGR_NOTIFY_PRICE, app_on_price_change, NULL) == 0 ||
+        PumpMgr_Subscribe(&s_app.mgr, 0, PUMP_MGR_NOTIFY_TOTALIZER, app_on_totalizer, NULL) == 0) {
+        CDC_Log(">>> ERROR: no subscription slot, prices and totalizers not saved");
+    }
     
     CDC_Log(">>> FSM initialized");
     
+    /* Host commands over USB CDC */
+    HostCmd_Init(&s_app.mgr, s_app.store, &s_app.upload, s_app.fsm, s_app.fsm_count);
+    
     /* Init UI */
-    UI_Init(&s_app.ui, &s_app.trk1_fsm, &s_app.trk2_fsm, &s_app.settings);
+    if (!UI_Init(&s_app.ui, s_app.fsm, s_app.fsm_count, &s_app.settings)) {
+        CDC_Log(">>> ERROR: no subscription slot, UI redraws on timer only");
+    }
     
     /* Init keyboard */
     KEYBOARD_Init();
@@ -78,9 +310,20 @@ void APP_Task(void)
 {
     /* Run managers */
     PumpMgr_Task(&s_app.mgr);
-    TrxFSM_Task(&s_app.trk1_fsm);
-    TrxFSM_Task(&s_app.trk2_fsm);
+    for (uint8_t k = 0; k < s_app.fsm_count; k++) {
+        TrxFSM_Task(s_app.fsm[k]);
+    }
     Settings_Task(&s_app.settings);
+    TrxJournal_Task(&s_app.journal);
+    HostCmd_Task();
+    TrxUpload_Task(&s_app.upload);
+    
+    if (s_app.settings_dirty && Settings_GetSaveState(&s_app.settings) != SETTINGS_SAVE_BUSY) {
+        Settings_CaptureFromPumpMgr(&s_app.settings, &s_app.mgr);
+        if (Settings_RequestSave(&s_app.settings)) {
+            s_app.settings_dirty = false;
+        }
+    }
 
     /* Read keyboard */
     char key = KEYBOARD_GetKey();
@@ -65,12 +65,21 @@ uint32_t CDC_LOG_GetDroppedCount(void)
     return s_dropped;
 }
 
+uint32_t CDC_LOG_GetFree(void)
+{
+    return ring_free(s_head, s_tail);
+}
+
 void CDC_LOG_Push(const char *s)
 {
     if (s == NULL) return;
 
-    uint32_t len = (uint32_t)strlen(s);
-    if (len == 0u) return;
+    CDC_LOG_PushBytes((const uint8_t *)s, (uint32_t)strlen(s));
+}
+
+void CDC_LOG_PushBytes(const uint8_t *s, uint32_t len)
+{
+    if (s == NULL || len == 0u) return;
 
     __disable_irq();
     uint32_t head = s_head;
@@ -86,7 +95,7 @@ void CDC_LOG_Push(const char *s)
 
     for (uint32_t i = 0; i < len; i++)
     {
-        s_ring[head] = (uint8_t)s[i];
+        s_ring[head] = s[i];
         head++;
         if (head >= CDC_LOG_RING_SIZE) head = 0;
     }
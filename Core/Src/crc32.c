@@ -0,0 +1,22 @@
+#include "crc32.h"
+
+/* crc is the running register (start with 0xFFFFFFFF, xor at the end) */
+uint32_t CRC32_Update(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+    uint32_t c = crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        c ^= (uint32_t)data[i];
+        for (uint8_t b = 0; b < 8; b++)
+        {
+            if (c & 1u) c = (c >> 1) ^ 0xEDB88320u;
+            else        c = (c >> 1);
+        }
+    }
+    return c;
+}
+
+uint32_t CRC32_Calc(const uint8_t *data, uint32_t len)
+{
+    return CRC32_Update(0xFFFFFFFFu, data, len) ^ 0xFFFFFFFFu;
+}
@@ -0,0 +1,125 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    fixed_dec.c
+  * @brief   Fixed-point decimal arithmetic for volume and money.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#include "fixed_dec.h"
+#include <stddef.h>
+
+/* q = round(n / d), d != 0; rem < d <= 2^32, so 2 * rem cannot overflow */
+static uint64_t fixdec_div(uint64_t n, uint64_t d, FixDecRound r)
+{
+    uint64_t q = n / d;
+    uint64_t rem = n - q * d;
+
+    switch (r)
+    {
+        case FIXDEC_ROUND_UP:
+            q += (rem != 0u) ? 1u : 0u;
+            break;
+        case FIXDEC_ROUND_HALF_UP:
+            q += (2u * rem >= d) ? 1u : 0u;
+            break;
+        case FIXDEC_ROUND_HALF_EVEN:
+            q += ((2u * rem > d) || ((2u * rem == d) && (q & 1u))) ? 1u : 0u;
+            break;
+        case FIXDEC_ROUND_DOWN:
+        default:
+            break;
+    }
+    return q;
+}
+
+bool FixDec_MulDiv(uint32_t a, uint32_t b, uint32_t d, FixDecRound r, uint32_t *out)
+{
+    if (out == NULL || d == 0u) return false;
+
+    uint64_t q = fixdec_div((uint64_t)a * b, d, r);
+    if (q > UINT32_MAX) return false;
+
+    *out = (uint32_t)q;
+    return true;
+}
+
+bool FixDec_Add(uint32_t a, uint32_t b, uint32_t *out)
+{
+    if (out == NULL || a > (UINT32_MAX - b)) return false;
+    *out = a + b;
+    return true;
+}
+
+bool FixDec_DLToCL(uint32_t volume_dL, uint32_t *volume_cL)
+{
+    return FixDec_MulDiv(volume_dL, FIXDEC_CL_PER_DL, 1u, FIXDEC_ROUND_DOWN, volume_cL);
+}
+
+uint32_t FixDec_CLToDL(uint32_t volume_cL, FixDecRound r)
+{
+    /* Quotient <= input: cannot overflow */
+    return (uint32_t)fixdec_div(volume_cL, FIXDEC_CL_PER_DL, r);
+}
+
+bool FixDec_MoneyOfDL(uint32_t volume_dL, uint32_t price, FixDecRound r, uint32_t *money)
+{
+    return FixDec_MulDiv(volume_dL, price, FIXDEC_DL_PER_L, r, money);
+}
+
+bool FixDec_MoneyOfMDL(uint32_t volume_mdL, uint32_t price, FixDecRound r, uint32_t *money)
+{
+    return FixDec_MulDiv(volume_mdL, price, FIXDEC_DL_PER_L * FIXDEC_MDL_PER_DL, r, money);
+}
+
+bool FixDec_DLOfMoney(uint32_t money, uint32_t price, FixDecRound r, uint32_t *volume_dL)
+{
+    return FixDec_MulDiv(money, FIXDEC_DL_PER_L, price, r, volume_dL);
+}
+
+bool FixDec_ParseDL(const char *s, uint8_t len, uint32_t *volume_dL)
+{
+    uint32_t litres = 0u;
+    uint32_t tenths = 0u;
+    uint8_t int_digits = 0u;
+    uint8_t frac_digits = 0u;
+    bool after_dot = false;
+
+    if (s == NULL || volume_dL == NULL || len == 0u) return false;
+
+    for (uint8_t i = 0u; i < len; i++)
+    {
+        if (s[i] == '.' && !after_dot)
+        {
+            after_dot = true;
+        }
+        else if (s[i] >= '0' && s[i] <= '9')
+        {
+            uint32_t d = (uint32_t)(s[i] - '0');
+            if (!after_dot)
+            {
+                int_digits++;
+                if (!FixDec_MulDiv(litres, 10u, 1u, FIXDEC_ROUND_DOWN, &litres) ||
+                    !FixDec_Add(litres, d, &litres)) return false;
+            }
+            else if (frac_digits++ == 0u)
+            {
+                tenths = d;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (int_digits == 0u && frac_digits == 0u) return false;
+
+    uint32_t dL;
+    if (!FixDec_MulDiv(litres, FIXDEC_DL_PER_L, 1u, FIXDEC_ROUND_DOWN, &dL) ||
+        !FixDec_Add(dL, tenths, &dL)) return false;
+
+    *volume_dL = dL;
+    return true;
+}
@@ -18,21 +18,22 @@
 static GKL_Link *s_links[GKL_MAX_LINKS];
 static uint8_t   s_links_count = 0;
 
-static void gkl_register_link(GKL_Link *link)
+/* false when the registry is full: the UART callbacks would never reach it */
+static bool gkl_register_link(GKL_Link *link)
 {
-    if (link == NULL || link->huart == NULL) return;
+    if (link == NULL || link->huart == NULL) return false;
 
     /* Already registered? */
     for (uint8_t i = 0; i < s_links_count; i++)
     {
-        if (s_links[i] == link) return;
-        if (s_links[i] && s_links[i]->huart == link->huart) return;
+        if (s_links[i] == link) return true;
+        if (s_links[i] && s_links[i]->huart == link->huart) return true;
     }
 
-    if (s_links_count < (uint8_t)GKL_MAX_LINKS)
-    {
-        s_links[s_links_count++] = link;
-    }
+    if (s_links_count >= (uint8_t)GKL_MAX_LINKS) return false;
+
+    s_links[s_links_count++] = link;
+    return true;
 }
 
 static GKL_Link *gkl_find_by_huart(UART_HandleTypeDef *huart)
@@ -127,13 +128,62 @@ static void gkl_rx_reset(GKL_Link *link)
     memset(link->rx_buf, 0, sizeof(link->rx_buf));
 }
 
+/* Exchange phases for bus time accounting */
+#define GKL_ACCT_TX     (0u)
+#define GKL_ACCT_WAIT   (1u)
+#define GKL_ACCT_RX     (2u)
+
+/* Close the running exchange: charge the time since the last phase change */
+static void gkl_account_end(GKL_Link *link, uint32_t now)
+{
+    if (!link->acct_active) return;
+    link->acct_active = 0u;
+
+    if (link->acct_phase == GKL_ACCT_RX)
+    {
+        link->time_rx_ms += now - link->acct_rx_start_ms;
+    }
+    else if (link->acct_phase == GKL_ACCT_WAIT)
+    {
+        link->time_wait_ms += now - link->tx_done_ms;
+    }
+    else
+    {
+        link->time_tx_ms += now - link->acct_tx_start_ms;
+    }
+    link->exchanges++;
+}
+
+/* A request is on the wire or waiting for its reply */
+static bool gkl_request_open(const GKL_Link *link)
+{
+    return link->state == GKL_STATE_TX_DMA || link->state == GKL_STATE_WAIT_RESP;
+}
+
+/* Hand the outcome to the request's owner; the slot is released */
+static void gkl_complete(GKL_Link *link, GKL_Result result, const GKL_Frame *fr)
+{
+    GKL_Completion *c = link->completion;
+    link->completion = NULL;
+
+    if (fr != NULL) c->frame = *fr;
+    c->result = result;
+    c->done = 1u;
+}
+
 static void gkl_fail(GKL_Link *link, GKL_Result err)
 {
     if (link == NULL) return;
+    gkl_rx_reset(link);
+
+    /* Garbage between requests fails nothing */
+    if (!gkl_request_open(link)) return;
+
+    gkl_account_end(link, HAL_GetTick());
     link->last_error = err;
     if (link->consecutive_fail < 255u) link->consecutive_fail++;
     link->state = GKL_STATE_ERROR;
-    gkl_rx_reset(link);
+    if (link->completion != NULL) gkl_complete(link, err, NULL);
 }
 
 static void gkl_success(GKL_Link *link)
@@ -168,33 +218,46 @@ static void gkl_try_finalize_frame_if_complete(GKL_Link *link)
         return;
     }
 
-    /* Validate response command (if set) */
-    if (link->expected_resp_cmd != 0 && (char)link->rx_buf[3] != link->expected_resp_cmd)
+    GKL_Frame fr;
+    fr.ctrl = link->rx_buf[1];
+    fr.slave = link->rx_buf[2];
+    fr.cmd = (char)link->rx_buf[3];
+    fr.checksum = recv;
+    fr.data_len = (uint8_t)(len - (1u + 2u + 1u + 1u));
+    if (fr.data_len > 0u)
     {
-        gkl_fail(link, GKL_ERR_FORMAT);
-        return;
+        memcpy(fr.data, &link->rx_buf[4], fr.data_len);
     }
 
-    /* Fill response */
-    link->last_resp.ctrl = link->rx_buf[1];
-    link->last_resp.slave = link->rx_buf[2];
-    link->last_resp.cmd = (char)link->rx_buf[3];
-    link->last_resp.checksum = recv;
+    link->rx_total_frames++;
+    gkl_rx_reset(link);
 
-    uint8_t data_len = (uint8_t)(len - (1u + 2u + 1u + 1u));
-    link->last_resp.data_len = data_len;
-    if (data_len > 0u)
+    /* Reply to the outstanding request: same addresses, expected command */
+    bool match = gkl_request_open(link) &&
+                 fr.ctrl == link->tx_buf[1] && fr.slave == link->tx_buf[2] &&
+                 (link->expected_resp_cmd == 0 || fr.cmd == link->expected_resp_cmd);
+    if (!match)
     {
-        memcpy(link->last_resp.data, &link->rx_buf[4], data_len);
+        link->unsol = fr;
+        link->unsol_ready = 1u;
+        link->rx_unsolicited++;
+        return;
     }
 
-    link->resp_ready = 1u;
-    link->state = GKL_STATE_GOT_RESP;
-
-    link->rx_total_frames++;
-
+    gkl_account_end(link, HAL_GetTick());
     gkl_success(link);
-    gkl_rx_reset(link);
+
+    if (link->completion != NULL)
+    {
+        gkl_complete(link, GKL_OK, &fr);
+        link->state = GKL_STATE_IDLE;
+    }
+    else
+    {
+        link->last_resp = fr;
+        link->resp_ready = 1u;
+        link->state = GKL_STATE_GOT_RESP;
+    }
 }
 
 /* ===================== Public API ===================== */
@@ -228,13 +291,17 @@ void GKL_Init(GKL_Link *link, UART_HandleTypeDef *huart)
 
     gkl_rx_reset(link);
 
-    gkl_register_link(link);
+    if (link->huart == NULL) return;
 
-    if (link->huart != NULL)
+    if (!gkl_register_link(link))
     {
-        /* Start 1-byte RX interrupt stream (non-blocking, no DMA ring) */
-        (void)HAL_UART_Receive_IT(link->huart, (uint8_t*)&link->rx_byte, 1u);
+        /* Registry full: callbacks could not reach this link, leave the UART alone */
+        link->last_error = GKL_ERR_PARAM;
+        return;
     }
+
+    /* Start 1-byte RX interrupt stream (non-blocking, no DMA ring) */
+    (void)HAL_UART_Receive_IT(link->huart, (uint8_t*)&link->rx_byte, 1u);
 }
 
 GKL_Result GKL_BuildFrame(uint8_t ctrl,
@@ -276,6 +343,18 @@ GKL_Result GKL_Send(GKL_Link *link,
                     const uint8_t *data,
                     uint8_t data_len,
                     char expected_resp_cmd)
+{
+    return GKL_SendEx(link, ctrl, slave, cmd, data, data_len, expected_resp_cmd, NULL);
+}
+
+GKL_Result GKL_SendEx(GKL_Link *link,
+                      uint8_t ctrl,
+                      uint8_t slave,
+                      char cmd,
+                      const uint8_t *data,
+                      uint8_t data_len,
+                      char expected_resp_cmd,
+                      GKL_Completion *done)
 {
     if (link == NULL || link->huart == NULL) return GKL_ERR_PARAM;
     if (data_len > GKL_MAX_DATA_LEN) return GKL_ERR_PARAM;
@@ -298,19 +377,10 @@ GKL_Result GKL_Send(GKL_Link *link,
     link->last_rx_byte = 0u;
     link->last_uart_error = 0u;
 
-    /* Store expected response command and pre-calc expected response length if known */
+    /* Store expected response command; the frame length is taken from the
+       command byte actually received, so an unsolicited frame is still framed */
     link->expected_resp_cmd = expected_resp_cmd;
 
-    uint8_t resp_data_len = gkl_resp_data_len_for_cmd(expected_resp_cmd);
-    if (resp_data_len != 0xFFu)
-    {
-        link->rx_expected_len = (uint8_t)(1u + 2u + 1u + resp_data_len + 1u);
-    }
-    else
-    {
-        link->rx_expected_len = 0u;
-    }
-
     /* Build TX frame */
     uint8_t out_len = 0u;
     GKL_Result br = GKL_BuildFrame(ctrl, slave, cmd, data, data_len, link->tx_buf, &out_len);
@@ -320,8 +390,21 @@ GKL_Result GKL_Send(GKL_Link *link,
     /* Clean DCache before DMA reads tx_buf */
     dcache_clean_by_addr(link->tx_buf, link->tx_len);
 
+    link->acct_tx_start_ms = HAL_GetTick();
+    link->acct_phase = GKL_ACCT_TX;
+    link->acct_active = 1u;
+
+    if (done != NULL)
+    {
+        done->done = 0u;
+        done->result = GKL_ERR_BUSY;
+    }
+    link->completion = done;
+
     if (HAL_UART_Transmit_DMA(link->huart, (uint8_t*)link->tx_buf, link->tx_len) != HAL_OK)
     {
+        link->completion = NULL;
+        link->acct_active = 0u;
         link->last_error = GKL_ERR_UART;
         if (link->consecutive_fail < 255u) link->consecutive_fail++;
         return GKL_ERR_UART;
@@ -352,6 +435,19 @@ bool GKL_GetResponse(GKL_Link *link, GKL_Frame *out)
     return true;
 }
 
+bool GKL_GetUnsolicited(GKL_Link *link, GKL_Frame *out)
+{
+    if (link == NULL || out == NULL) return false;
+    if (link->unsol_ready == 0u) return false;
+
+    __disable_irq();
+    *out = link->unsol;
+    link->unsol_ready = 0u;
+    __enable_irq();
+
+    return true;
+}
+
 GKL_Stats GKL_GetStats(GKL_Link *link)
 {
     GKL_Stats st;
@@ -364,6 +460,12 @@ GKL_Stats GKL_GetStats(GKL_Link *link)
     st.rx_len = 0u;
     st.rx_total_bytes = 0u;
     st.rx_total_frames = 0u;
+    st.rx_unsolicited = 0u;
+
+    st.time_tx_ms = 0u;
+    st.time_wait_ms = 0u;
+    st.time_rx_ms = 0u;
+    st.exchanges = 0u;
 
     if (link == NULL)
     {
@@ -379,6 +481,12 @@ GKL_Stats GKL_GetStats(GKL_Link *link)
     st.rx_len = link->rx_len;
     st.rx_total_bytes = link->rx_total_bytes;
     st.rx_total_frames = link->rx_total_frames;
+    st.rx_unsolicited = link->rx_unsolicited;
+
+    st.time_tx_ms = link->time_tx_ms;
+    st.time_wait_ms = link->time_wait_ms;
+    st.time_rx_ms = link->time_rx_ms;
+    st.exchanges = link->exchanges;
     return st;
 }
 
@@ -421,6 +529,12 @@ void GKL_Global_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 
     link->tx_done_ms = HAL_GetTick();
     link->state = GKL_STATE_WAIT_RESP;
+
+    if (link->acct_active)
+    {
+        link->time_tx_ms += link->tx_done_ms - link->acct_tx_start_ms;
+        link->acct_phase = GKL_ACCT_WAIT;
+    }
 }
 
 void GKL_Global_UART_RxCpltCallback(UART_HandleTypeDef *huart)
@@ -436,6 +550,14 @@ void GKL_Global_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 
     link->last_rx_byte_ms = now;
 
+    /* First response byte ends the wait phase */
+    if (link->acct_active && link->acct_phase == GKL_ACCT_WAIT)
+    {
+        link->time_wait_ms += now - link->tx_done_ms;
+        link->acct_rx_start_ms = now;
+        link->acct_phase = GKL_ACCT_RX;
+    }
+
     /* RX diagnostics */
     link->rx_seen_since_tx = 1u;
     link->last_rx_byte = b;
@@ -460,6 +582,16 @@ void GKL_Global_UART_RxCpltCallback(UART_HandleTypeDef *huart)
         goto rearm;
     }
 
+    /* Command byte in: frame length is known for fixed-size replies */
+    if (link->rx_len == 4u)
+    {
+        uint8_t resp_data_len = gkl_resp_data_len_for_cmd((char)link->rx_buf[3]);
+        if (resp_data_len != 0xFFu)
+        {
+            link->rx_expected_len = (uint8_t)(1u + 2u + 1u + resp_data_len + 1u);
+        }
+    }
+
     gkl_try_finalize_frame_if_complete(link);
 
 rearm:
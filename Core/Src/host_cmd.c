@@ -0,0 +1,314 @@
+#include "host_cmd.h"
+#include "cdc_logger.h"
+#include "fixed_dec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* RX ring: written from the USB IRQ, read by Task() */
+static uint8_t s_rx[HOST_CMD_RX_SIZE];
+static volatile uint32_t s_rx_head = 0;
+static volatile uint32_t s_rx_tail = 0;
+
+static char s_line[HOST_CMD_LINE_MAX];
+static uint32_t s_line_len = 0;
+
+static PumpMgr *s_mgr = NULL;
+static TrxStore *s_store = NULL;
+static TrxUpload *s_upload = NULL;
+static TransactionFSM *const *s_fsm = NULL;
+static uint8_t s_fsm_count = 0;
+
+/* Paged HIST answer in progress */
+static TrxStoreCursor s_cur;
+static uint8_t  s_cur_active = 0;
+static uint32_t s_cur_sent = 0;
+
+/* Paged MET answer in progress (NULL = none) */
+static const TransactionFSM *s_met_fsm = NULL;
+static uint8_t s_met_next = 0;
+
+void HostCmd_Init(PumpMgr *mgr, TrxStore *store, TrxUpload *upload, TransactionFSM *const *fsm, uint8_t fsm_count)
+{
+    s_mgr = mgr;
+    s_store = store;
+    s_upload = upload;
+    s_fsm = fsm;
+    s_fsm_count = fsm_count;
+    s_met_fsm = NULL;
+    s_rx_head = 0;
+    s_rx_tail = 0;
+    s_line_len = 0;
+    s_cur_active = 0;
+}
+
+void HostCmd_OnRx(const uint8_t *buf, uint32_t len)
+{
+    if (buf == NULL) return;
+
+    uint32_t head = s_rx_head;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t next = (head + 1u) % HOST_CMD_RX_SIZE;
+        if (next == s_rx_tail) break;   /* full: rest of the packet is lost */
+        s_rx[head] = buf[i];
+        head = next;
+    }
+    s_rx_head = head;
+}
+
+/* Next complete line from the RX ring */
+static bool hostcmd_read_line(void)
+{
+    while (s_rx_tail != s_rx_head)
+    {
+        char ch = (char)s_rx[s_rx_tail];
+        s_rx_tail = (s_rx_tail + 1u) % HOST_CMD_RX_SIZE;
+
+        if (ch == '\r' || ch == '\n')
+        {
+            if (s_line_len == 0u) continue;
+            s_line[s_line_len] = '\0';
+            s_line_len = 0;
+            return true;
+        }
+        if (s_line_len < (HOST_CMD_LINE_MAX - 1u))
+        {
+            s_line[s_line_len++] = ch;
+        }
+    }
+    return false;
+}
+
+/* "<pump> <from> <to> [nozzle]" */
+static bool hostcmd_parse_range(const char *args, uint8_t *pump, uint8_t *nozzle,
+                                uint32_t *from_ms, uint32_t *to_ms)
+{
+    char *end;
+    unsigned long v[4] = { 0, 0, 0, 0 };
+    uint8_t n = 0;
+
+    while (n < 4u)
+    {
+        v[n] = strtoul(args, &end, 10);
+        if (end == args) break;
+        args = end;
+        n++;
+    }
+    if (n < 3u || v[0] > 255u || v[3] > 255u) return false;
+
+    *pump = (uint8_t)v[0];
+    *from_ms = (uint32_t)v[1];
+    *to_ms = (uint32_t)v[2];
+    *nozzle = (uint8_t)v[3];
+    return true;
+}
+
+/* "<pump|0> <price> [<pump> <price>...]" -> price table, 0 = every pump */
+static uint8_t hostcmd_parse_prices(const char *args, PumpPriceEntry *table)
+{
+    uint8_t n = 0;
+    char *end;
+
+    for (;;)
+    {
+        unsigned long id = strtoul(args, &end, 10);
+        if (end == args) break;
+        args = end;
+        unsigned long price = strtoul(args, &end, 10);
+        if (end == args || id > 255u || price > HOST_CMD_PRICE_MAX) return 0;
+        args = end;
+
+        if (id == 0u)
+        {
+            for (uint8_t i = 0; i < s_mgr->count; i++)
+            {
+                table[i].id = s_mgr->pumps[i].id;
+                table[i].price = (uint32_t)price;
+            }
+            return s_mgr->count;
+        }
+        if (n >= PUMP_MGR_MAX_PUMPS) return 0;
+        table[n].id = (uint8_t)id;
+        table[n].price = (uint32_t)price;
+        n++;
+    }
+    return n;
+}
+
+static void hostcmd_exec(const char *line)
+{
+    char msg[96];
+    uint8_t pump, nozzle;
+    uint32_t from_ms, to_ms;
+
+    if (s_store == NULL)
+    {
+        CDC_Log("ERR no store");
+    }
+    else if (strncmp(line, "HIST ", 5) == 0 &&
+             hostcmd_parse_range(&line[5], &pump, &nozzle, &from_ms, &to_ms))
+    {
+        TrxStore_Seek(s_store, &s_cur, pump, nozzle, from_ms, to_ms);
+        s_cur_active = 1u;
+        s_cur_sent = 0u;
+    }
+    else if (strncmp(line, "SUM ", 4) == 0 &&
+             hostcmd_parse_range(&line[4], &pump, &nozzle, &from_ms, &to_ms))
+    {
+        TrxStoreCursor c;
+        TrxSale s;
+        uint32_t n = 0, vol = 0, money = 0;
+        bool ok = true;
+
+        TrxStore_Seek(s_store, &c, pump, nozzle, from_ms, to_ms);
+        while (TrxStore_Next(s_store, &c, &s))
+        {
+            n++;
+            ok = ok && FixDec_Add(vol, s.volume_dL, &vol) && FixDec_Add(money, s.money, &money);
+        }
+        /* A total that does not fit is reported as such, never wrapped */
+        snprintf(msg, sizeof(msg), ok ? "SUM %lu %lu %lu" : "SUM %lu %lu %lu OVF",
+                 (unsigned long)n, (unsigned long)vol, (unsigned long)money);
+        CDC_Log(msg);
+    }
+    else if (strcmp(line, "STORE") == 0)
+    {
+        snprintf(msg, sizeof(msg), "STORE %lu %lu %lu %lu %lu",
+                 (unsigned long)TrxStore_Count(s_store), (unsigned long)TRX_STORE_CAPACITY,
+                 (unsigned long)TrxStore_OldestSeq(s_store), (unsigned long)s_store->next_seq,
+                 (unsigned long)TrxUpload_Backlog(s_upload));
+        CDC_Log(msg);
+    }
+    else if (strcmp(line, "UPL") == 0 || strcmp(line, "UPL R") == 0)
+    {
+        /* A batch still queued: the host asked too early, it will get that one */
+        (void)TrxUpload_Request(s_upload, line[3] == ' ');
+    }
+    else if (strncmp(line, "ACK ", 4) == 0)
+    {
+        char *end;
+        unsigned long seq = strtoul(&line[4], &end, 10);
+        if (end != &line[4] && TrxUpload_Ack(s_upload, (uint32_t)seq))
+        {
+            snprintf(msg, sizeof(msg), "ACK %lu", seq);
+            CDC_Log(msg);
+        }
+        else
+        {
+            CDC_Log("ERR");
+        }
+    }
+    else if (s_mgr != NULL && strcmp(line, "PRICE") == 0)
+    {
+        snprintf(msg, sizeof(msg), "PRICE %u %lu", (unsigned)PumpMgr_PriceJobState(s_mgr),
+                 (unsigned long)PumpMgr_GetPriceGeneration(s_mgr));
+        CDC_Log(msg);
+    }
+    else if (s_mgr != NULL && strncmp(line, "PRICE ", 6) == 0)
+    {
+        static PumpPriceEntry table[PUMP_MGR_MAX_PUMPS];
+        uint8_t n = hostcmd_parse_prices(&line[6], table);
+        if (n != 0u && PumpMgr_PriceJobStart(s_mgr, table, n, 0u))
+        {
+            snprintf(msg, sizeof(msg), "PRICE %u", (unsigned)n);
+            CDC_Log(msg);
+        }
+        else
+        {
+            CDC_Log("ERR");
+        }
+    }
+    else if (strncmp(line, "MET ", 4) == 0)
+    {
+        unsigned long id = strtoul(&line[4], NULL, 10);
+        for (uint8_t k = 0; k < s_fsm_count; k++)
+        {
+            if (s_fsm[k] != NULL && s_fsm[k]->pump_id == id) s_met_fsm = s_fsm[k];
+        }
+        s_met_next = 0u;
+        if (s_met_fsm == NULL) CDC_Log("ERR");
+    }
+    else
+    {
+        CDC_Log("ERR");
+    }
+}
+
+/* Page the MET answer out, one metric per line */
+static void hostcmd_page_met(void)
+{
+    char msg[HOST_CMD_MET_ROOM];
+
+    while (CDC_LOG_GetFree() >= HOST_CMD_MET_ROOM)
+    {
+        if (s_met_next >= (uint8_t)TRX_MET_COUNT)
+        {
+            snprintf(msg, sizeof(msg), "END %u", (unsigned)TRX_MET_COUNT);
+            CDC_Log(msg);
+            s_met_fsm = NULL;
+            return;
+        }
+
+        const TrxMetricHist *h = &TrxFSM_GetMetrics(s_met_fsm)->hist[s_met_next];
+        uint32_t avg = h->count ? (uint32_t)(h->sum / h->count) : 0u;
+        int pos = snprintf(msg, sizeof(msg), "MET %u %s %lu %lu %lu",
+                           (unsigned)s_met_fsm->pump_id, TrxMetrics_Name((TrxMetric)s_met_next),
+                           (unsigned long)h->count, (unsigned long)avg, (unsigned long)h->max);
+        for (uint8_t b = 0; b < TRX_METRICS_BUCKETS && pos > 0 && (uint32_t)pos < sizeof(msg); b++)
+        {
+            pos += snprintf(&msg[pos], sizeof(msg) - (uint32_t)pos, " %u", (unsigned)h->bucket[b]);
+        }
+        CDC_Log(msg);
+        s_met_next++;
+    }
+}
+
+/* Page the HIST answer out as the logger has room */
+static void hostcmd_page(void)
+{
+    char msg[HOST_CMD_LINE_ROOM];
+    TrxSale s;
+
+    for (uint8_t i = 0; i < HOST_CMD_LINES_PER_PASS; i++)
+    {
+        if (CDC_LOG_GetFree() < HOST_CMD_LINE_ROOM) return;
+
+        if (!TrxStore_Next(s_store, &s_cur, &s))
+        {
+            snprintf(msg, sizeof(msg), "END %lu", (unsigned long)s_cur_sent);
+            CDC_Log(msg);
+            s_cur_active = 0u;
+            return;
+        }
+
+        /* SALE seq pump nozzle volume_dL money price preset flags start end tot_before tot_after recon */
+        snprintf(msg, sizeof(msg), "SALE %lu %u %u %lu %lu %lu %lu %u %lu %lu %lu %lu %u",
+                 (unsigned long)s.seq, (unsigned)s.pump_id, (unsigned)s.nozzle,
+                 (unsigned long)s.volume_dL, (unsigned long)s.money, (unsigned long)s.price,
+                 (unsigned long)s.preset, (unsigned)s.flags,
+                 (unsigned long)s.start_ms, (unsigned long)s.end_ms,
+                 (unsigned long)s.tot_before_cL, (unsigned long)s.tot_after_cL, (unsigned)s.recon);
+        CDC_Log(msg);
+        s_cur_sent++;
+    }
+}
+
+void HostCmd_Task(void)
+{
+    if (s_cur_active)
+    {
+        hostcmd_page();
+        return;
+    }
+    if (s_met_fsm != NULL)
+    {
+        hostcmd_page_met();
+        return;
+    }
+
+    if (hostcmd_read_line())
+    {
+        hostcmd_exec(s_line);
+    }
+}
@@ -187,8 +187,10 @@ int main(void) {
 	HAL_TIM_Base_Start_IT(&htim3);
 
 	/* Application init (protocol plugins + UI + managers)
-	 NOTE: USART2/USART3 are reserved for TRK links (no USART2 logging). */
-	APP_Init(&huart2, &huart3, &hi2c1);
+	 NOTE: USART2/USART3 are reserved for TRK links (no USART2 logging).
+	 Settings pump.link indexes this table. */
+	static UART_HandleTypeDef *const trk_uarts[] = { &huart2, &huart3 };
+	APP_Init(trk_uarts, 2u, &hi2c1);
 	/* USER CODE END 2 */
 
 	/* Infinite loop */
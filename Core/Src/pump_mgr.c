@@ -13,71 +13,341 @@
 #include <string.h>
 #include <stdio.h>
 
+/* ===================== Scheduling helpers ===================== */
+
+/* Wrap-safe "deadline reached" check for HAL_GetTick() values */
+static bool pumpmgr_is_due(uint32_t now, uint32_t deadline)
+{
+    return ((int32_t)(now - deadline) >= 0);
+}
+
+/* Poll period that matches the current pump state */
+static uint32_t pumpmgr_poll_period(const PumpMgr *m, uint8_t idx)
+{
+    /* Quarantine probes keep their own backoff, capped at PUMP_MGR_PROBE_MAX_MS:
+       stretching it too would keep a recovered pump offline for minutes */
+    if (m->hot.health[idx] == PUMP_HEALTH_QUARANTINED) return m->pumps[idx].probe_backoff_ms;
+
+    /* Background polls are stretched by the bus governor, fast ones never */
+    uint32_t stretch = m->bus[m->pumps[idx].link].stretch;
+    if (stretch == 0u) stretch = 1u;
+
+    /* 0/1 = nozzle down, nothing going on; everything else needs fast reaction */
+    if (m->hot.status[idx] <= 1u) return m->poll_period_ms * stretch;
+    return m->poll_fast_ms;
+}
+
+/* Pull the next poll in if the new state wants a shorter period */
+static void pumpmgr_reschedule(PumpMgr *m, uint8_t idx, uint32_t now)
+{
+    uint32_t next = now + pumpmgr_poll_period(m, idx);
+    if ((int32_t)(next - m->hot.next_poll_ms[idx]) < 0)
+    {
+        m->hot.next_poll_ms[idx] = next;
+    }
+}
+
+/* Expected exchange duration on a bus: measured average, else the estimate */
+static uint32_t pumpmgr_exchange_ms(const PumpMgrBus *b)
+{
+    PumpBusTime t;
+    if (PumpProto_GetBusTime(&b->proto, &t) && t.exchanges != 0u)
+    {
+        uint32_t avg = (t.tx_ms + t.wait_ms + t.rx_ms) / t.exchanges;
+        if (avg != 0u) return avg;
+    }
+    return PUMP_MGR_EXCHANGE_EST_MS;
+}
+
+/* Spread the pumps of one bus evenly over the idle poll period, at least one
+   exchange apart, and skew buses against each other so their TX/RX
+   interrupts and log lines do not line up either. */
+static void pumpmgr_spread_phases(PumpMgr *m, uint8_t bi, uint32_t now)
+{
+    const PumpMgrBus *b = &m->bus[bi];
+    if (b->dev_count == 0u) return;
+
+    uint32_t step = m->poll_period_ms / b->dev_count;
+    uint32_t exch = pumpmgr_exchange_ms(b);
+    if (step < exch) step = exch;
+
+    uint32_t skew = (m->bus_count > 1u) ? ((step * bi) / m->bus_count) : 0u;
+
+    for (uint8_t k = 0u; k < b->dev_count; k++)
+    {
+        m->hot.next_poll_ms[b->dev[k]] = now + skew + step * k;
+    }
+}
+
+/* ===================== State update (seqlock writer) ===================== */
+
+/* Only the main loop writes PumpDevice; readers retry instead of locking */
+static void pumpmgr_write_begin(PumpDevice *d)
+{
+    d->seq++;
+    __DMB();
+}
+
+static void pumpmgr_write_end(PumpDevice *d)
+{
+    __DMB();
+    d->seq++;
+}
+
+/* ===================== Change notifications ===================== */
+
+static void pumpmgr_notify(const PumpMgr *m, const PumpMgrNotify *n)
+{
+    for (uint8_t i = 0u; i < (uint8_t)PUMP_MGR_MAX_SUBS; i++)
+    {
+        const PumpMgrSub *sub = &m->subs[i];
+        if (sub->fn == NULL) continue;
+        if ((sub->mask & n->what) == 0u) continue;
+        if (sub->pump_id != 0u && sub->pump_id != n->pump_id) continue;
+        sub->fn(sub->ctx, n);
+    }
+}
+
+/* ===================== Lookup helpers ===================== */
+
+static uint8_t pumpmgr_index_of(const PumpMgr *m, uint8_t id)
+{
+    uint8_t idx = m->index_by_id[id];
+    if (idx >= m->count) return PUMP_MGR_NO_INDEX;
+    return idx;
+}
+
+/* Device index by bus address; ctrl must match too (key is link/ctrl/slave) */
+static uint8_t pumpmgr_index_by_addr(const PumpMgr *m, uint8_t link, uint8_t ctrl, uint8_t slave)
+{
+    if (link >= m->bus_count || slave > (uint8_t)PUMP_MGR_MAX_SLAVE_ADDR) return PUMP_MGR_NO_INDEX;
+
+    uint8_t idx = m->index_by_addr[link][slave];
+    if (idx >= m->count) return PUMP_MGR_NO_INDEX;
+    if (m->pumps[idx].ctrl_addr != ctrl) return PUMP_MGR_NO_INDEX;
+    return idx;
+}
+
+/* Bus index for a protocol handle, NO_INDEX if it has none yet.
+   Pumps bound to the same protocol context share one bus. */
+static uint8_t pumpmgr_find_bus(const PumpMgr *m, const PumpProto *proto)
+{
+    for (uint8_t i = 0u; i < m->bus_count; i++)
+    {
+        if (m->bus[i].proto.ctx == proto->ctx) return i;
+    }
+    return PUMP_MGR_NO_INDEX;
+}
+
+/* Bus index for a protocol handle, creating the bus on first use */
+static uint8_t pumpmgr_bus_of(PumpMgr *m, const PumpProto *proto)
+{
+    uint8_t i = pumpmgr_find_bus(m, proto);
+    if (i != PUMP_MGR_NO_INDEX) return i;
+    if (m->bus_count >= (uint8_t)PUMP_MGR_MAX_LINKS) return PUMP_MGR_NO_INDEX;
+
+    PumpMgrBus *b = &m->bus[m->bus_count];
+    memset(b, 0, sizeof(*b));
+    b->proto = *proto;  /* Copy struct, once per link */
+    b->stretch = 1u;
+    b->win_start_ms = HAL_GetTick();
+    (void)PumpProto_GetBusTime(&b->proto, &b->win_start);
+    return m->bus_count++;
+}
+
 void PumpMgr_Init(PumpMgr *m, uint32_t poll_period_ms)
 {
     if (m == NULL) return;
     memset(m, 0, sizeof(*m));
     m->poll_period_ms = poll_period_ms;
-    for (uint8_t i = 0u; i < (uint8_t)PUMP_MGR_MAX_PUMPS; i++)
-    {
-        m->next_poll_ms[i] = 0u;
-    }
+    m->poll_fast_ms = PUMP_MGR_POLL_FAST_MS;
+    m->poll_offline_ms = PUMP_MGR_POLL_OFFLINE_MS;
+    m->util_target_permille = PUMP_MGR_UTIL_TARGET_PERMILLE;
+    memset(m->index_by_id, PUMP_MGR_NO_INDEX, sizeof(m->index_by_id));
+    memset(m->index_by_addr, PUMP_MGR_NO_INDEX, sizeof(m->index_by_addr));
+}
+
+void PumpMgr_SetPollRates(PumpMgr *m, uint32_t idle_ms, uint32_t fast_ms, uint32_t offline_ms)
+{
+    if (m == NULL) return;
+    if (idle_ms != 0u) m->poll_period_ms = idle_ms;
+    if (fast_ms != 0u) m->poll_fast_ms = fast_ms;
+    if (offline_ms != 0u) m->poll_offline_ms = offline_ms;
+}
+
+void PumpMgr_SetUtilTarget(PumpMgr *m, uint16_t permille)
+{
+    if (m == NULL) return;
+    if (permille > 1000u) permille = 1000u;
+    m->util_target_permille = permille;
+}
+
+bool PumpMgr_GetBusStats(const PumpMgr *m, uint8_t bus, PumpMgrBusStats *out)
+{
+    if (m == NULL || out == NULL || bus >= m->bus_count) return false;
+    const PumpMgrBus *b = &m->bus[bus];
+
+    memset(out, 0, sizeof(*out));
+    out->util_permille = b->util_permille;
+    out->tx_permille = b->tx_permille;
+    out->wait_permille = b->wait_permille;
+    out->rx_permille = b->rx_permille;
+
+    uint32_t busy = (uint32_t)b->tx_permille + b->wait_permille + b->rx_permille;
+    out->idle_permille = (busy >= 1000u) ? 0u : (uint16_t)(1000u - busy);
+    out->stretch = b->stretch;
+    out->dev_count = b->dev_count;
+
+    PumpBusTime t;
+    if (PumpProto_GetBusTime(&b->proto, &t)) out->exchanges = t.exchanges;
+    return true;
 }
 
 bool PumpMgr_Add(PumpMgr *m, uint8_t id, PumpProto *proto, uint8_t ctrl_addr, uint8_t slave_addr)
 {
     if (m == NULL || proto == NULL) return false;
     if (m->count >= (uint8_t)PUMP_MGR_MAX_PUMPS) return false;
+    if (slave_addr > (uint8_t)PUMP_MGR_MAX_SLAVE_ADDR) return false;
 
     /* Ensure unique id */
-    for (uint8_t i = 0u; i < m->count; i++)
-    {
-        if (m->pumps[i].id == id) return false;
-    }
+    if (pumpmgr_index_of(m, id) != PUMP_MGR_NO_INDEX) return false;
+
+    /* Ensure unique bus address before a new bus is created for it */
+    uint8_t link = pumpmgr_find_bus(m, proto);
+    if (link != PUMP_MGR_NO_INDEX && m->index_by_addr[link][slave_addr] != PUMP_MGR_NO_INDEX) return false;
+    link = pumpmgr_bus_of(m, proto);
+    if (link == PUMP_MGR_NO_INDEX) return false;
 
     PumpDevice *d = &m->pumps[m->count];
     memset(d, 0, sizeof(*d));
     d->id = id;
-    d->proto = *proto;  /* Copy struct */
+    d->link = link;
     d->ctrl_addr = ctrl_addr;
     d->slave_addr = slave_addr;
     d->price = 0u;
-    d->status = 0u;
-    d->nozzle = 0u;
     d->last_status_ms = 0u;
     d->last_error = 0u;
-    d->fail_count = 0u;
+    d->nozzle_count = 1u;
+
+    memset(m->tot[m->count], 0, sizeof(m->tot[0]));
+    m->tot_want[m->count] = 0u;
+
+    m->hot.next_poll_ms[m->count] = HAL_GetTick();
+    m->hot.urgent[m->count] = 0u;
+    m->hot.status[m->count] = 0u;
+    m->hot.nozzle[m->count] = 0u;
+    m->hot.health[m->count] = PUMP_HEALTH_ONLINE;
+    m->hot.fail_count[m->count] = 0u;
+    m->index_by_id[id] = m->count;
+    m->index_by_addr[link][slave_addr] = m->count;
+
+    PumpMgrBus *b = &m->bus[link];
+    b->dev[b->dev_count++] = m->count;
 
-    m->next_poll_ms[m->count] = 0u;
     m->count++;
+    pumpmgr_spread_phases(m, link, HAL_GetTick());
     return true;
 }
 
 PumpDevice *PumpMgr_Get(PumpMgr *m, uint8_t id)
 {
     if (m == NULL) return NULL;
-    for (uint8_t i = 0u; i < m->count; i++)
-    {
-        if (m->pumps[i].id == id) return &m->pumps[i];
-    }
-    return NULL;
+    uint8_t idx = pumpmgr_index_of(m, id);
+    if (idx == PUMP_MGR_NO_INDEX) return NULL;
+    return &m->pumps[idx];
 }
 
 const PumpDevice *PumpMgr_GetConst(const PumpMgr *m, uint8_t id)
 {
     if (m == NULL) return NULL;
-    for (uint8_t i = 0u; i < m->count; i++)
+    uint8_t idx = pumpmgr_index_of(m, id);
+    if (idx == PUMP_MGR_NO_INDEX) return NULL;
+    return &m->pumps[idx];
+}
+
+bool PumpMgr_Snapshot(const PumpMgr *m, uint8_t id, PumpSnapshot *out)
+{
+    if (m == NULL || out == NULL) return false;
+    uint8_t idx = pumpmgr_index_of(m, id);
+    if (idx == PUMP_MGR_NO_INDEX) return false;
+
+    const PumpDevice *d = &m->pumps[idx];
+    for (uint8_t attempt = 0u; attempt < (uint8_t)PUMP_MGR_SNAPSHOT_RETRIES; attempt++)
+    {
+        uint32_t seq = d->seq;
+        if (seq & 1u) continue;     /* update in progress */
+        __DMB();
+
+        out->id = d->id;
+        out->ctrl_addr = d->ctrl_addr;
+        out->slave_addr = d->slave_addr;
+        out->status = m->hot.status[idx];
+        out->nozzle = m->hot.nozzle[idx];
+        out->last_error = d->last_error;
+        out->fail_count = m->hot.fail_count[idx];
+        out->health = m->hot.health[idx];
+        out->probe_backoff_ms = d->probe_backoff_ms;
+        out->quarantine_count = d->quarantine_count;
+        out->price = d->price;
+        out->last_status_ms = d->last_status_ms;
+        out->last_seen_ms = d->last_seen_ms;
+
+        __DMB();
+        if (d->seq == seq)
+        {
+            out->seq = seq;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t PumpMgr_Subscribe(PumpMgr *m, uint8_t pump_id, uint8_t mask, PumpMgrNotifyFn fn, void *ctx)
+{
+    if (m == NULL || fn == NULL || mask == 0u) return 0u;
+
+    for (uint8_t i = 0u; i < (uint8_t)PUMP_MGR_MAX_SUBS; i++)
     {
-        if (m->pumps[i].id == id) return &m->pumps[i];
+        PumpMgrSub *sub = &m->subs[i];
+        if (sub->fn != NULL) continue;
+        sub->fn = fn;
+        sub->ctx = ctx;
+        sub->pump_id = pump_id;
+        sub->mask = mask;
+        return (uint8_t)(i + 1u);
     }
-    return NULL;
+    return 0u;
+}
+
+void PumpMgr_Unsubscribe(PumpMgr *m, uint8_t handle)
+{
+    /* handle 0 wraps to 255, beyond any table (PUMP_MGR_MAX_SUBS <= 255) */
+    if (m == NULL || (uint8_t)(handle - 1u) >= PUMP_MGR_MAX_SUBS) return;
+    memset(&m->subs[handle - 1u], 0, sizeof(m->subs[0]));
+}
+
+/* Write one price and tell subscribers (caller checked the device) */
+static void pumpmgr_apply_price(PumpMgr *m, PumpDevice *d, uint32_t price)
+{
+    if (d->price == price) return;
+
+    pumpmgr_write_begin(d);
+    d->price = price;
+    pumpmgr_write_end(d);
+
+    PumpMgrNotify n;
+    memset(&n, 0, sizeof(n));
+    n.pump_id = d->id;
+    n.what = PUMP_MGR_NOTIFY_PRICE;
+    n.price = price;
+    pumpmgr_notify(m, &n);
 }
 
 bool PumpMgr_SetPrice(PumpMgr *m, uint8_t id, uint32_t price)
 {
     PumpDevice *d = PumpMgr_Get(m, id);
     if (d == NULL) return false;
-    d->price = price;
+    pumpmgr_apply_price(m, d, price);
     return true;
 }
 
@@ -88,11 +358,121 @@ uint32_t PumpMgr_GetPrice(const PumpMgr *m, uint8_t id)
     return d->price;
 }
 
+bool PumpMgr_PriceJobStart(PumpMgr *m, const PumpPriceEntry *table, uint8_t count, uint32_t timeout_ms)
+{
+    if (m == NULL || table == NULL || count == 0u) return false;
+
+    PumpPriceJob *job = &m->price_job;
+    if (job->state == PUMP_PRICE_JOB_PENDING) return false;
+
+    /* Validate the whole table before touching anything */
+    for (uint8_t k = 0u; k < count; k++)
+    {
+        if (pumpmgr_index_of(m, table[k].id) == PUMP_MGR_NO_INDEX) return false;
+    }
+
+    uint32_t now = HAL_GetTick();
+    memset(job, 0, sizeof(*job));
+    job->start_ms = now;
+    job->deadline_ms = now + ((timeout_ms != 0u) ? timeout_ms : (uint32_t)PUMP_MGR_PRICE_JOB_TIMEOUT_MS);
+
+    for (uint8_t k = 0u; k < count; k++)
+    {
+        uint8_t i = pumpmgr_index_of(m, table[k].id);
+        job->member[i] = 1u;
+        job->price[i] = table[k].price;
+
+        /* Quarantined pumps cannot authorise; they get the price with their next preset */
+        if (m->hot.health[i] == PUMP_HEALTH_QUARANTINED)
+        {
+            job->confirmed[i] = 1u;
+        }
+        else
+        {
+            m->hot.next_poll_ms[i] = now;
+            m->hot.urgent[i] = 1u;
+        }
+    }
+    job->state = PUMP_PRICE_JOB_PENDING;
+
+    char msg[48];
+    (void)snprintf(msg, sizeof(msg), "PumpMgr: price job start (%u pumps)", (unsigned)count);
+    CDC_Log(msg);
+    return true;
+}
+
+PumpPriceJobState PumpMgr_PriceJobState(const PumpMgr *m)
+{
+    if (m == NULL) return PUMP_PRICE_JOB_IDLE;
+    return (PumpPriceJobState)m->price_job.state;
+}
+
+uint32_t PumpMgr_GetPriceGeneration(const PumpMgr *m)
+{
+    if (m == NULL) return 0u;
+    return m->price_gen;
+}
+
+bool PumpMgr_CanAuthorise(const PumpMgr *m, uint8_t id)
+{
+    if (m == NULL) return false;
+    uint8_t idx = pumpmgr_index_of(m, id);
+    if (idx == PUMP_MGR_NO_INDEX) return false;
+    if (m->price_job.state == PUMP_PRICE_JOB_PENDING && m->price_job.member[idx]) return false;
+    return true;
+}
+
+/* Commit when every member confirmed, abort at the deadline */
+static void pumpmgr_price_job_task(PumpMgr *m, uint32_t now)
+{
+    PumpPriceJob *job = &m->price_job;
+    if (job->state != PUMP_PRICE_JOB_PENDING) return;
+
+    bool all = true;
+    for (uint8_t i = 0u; i < m->count; i++)
+    {
+        if (job->member[i] && !job->confirmed[i])
+        {
+            all = false;
+            break;
+        }
+    }
+
+    char msg[64];
+    if (all)
+    {
+        job->state = PUMP_PRICE_JOB_COMMITTED;
+        m->price_gen++;
+        for (uint8_t i = 0u; i < m->count; i++)
+        {
+            if (job->member[i]) pumpmgr_apply_price(m, &m->pumps[i], job->price[i]);
+        }
+        (void)snprintf(msg, sizeof(msg), "PumpMgr: prices committed gen %lu in %lu ms",
+                       (unsigned long)m->price_gen, (unsigned long)(now - job->start_ms));
+        CDC_Log(msg);
+    }
+    else if (pumpmgr_is_due(now, job->deadline_ms))
+    {
+        job->state = PUMP_PRICE_JOB_ABORTED;
+        CDC_Log("PumpMgr: price job timed out, prices unchanged");
+    }
+}
+
 bool PumpMgr_SetSlaveAddr(PumpMgr *m, uint8_t id, uint8_t slave_addr)
 {
     PumpDevice *d = PumpMgr_Get(m, id);
     if (d == NULL) return false;
+    if (slave_addr > (uint8_t)PUMP_MGR_MAX_SLAVE_ADDR) return false;
+    if (slave_addr == d->slave_addr) return true;
+
+    /* Keep the address index in sync; refuse to alias another pump */
+    if (m->index_by_addr[d->link][slave_addr] != PUMP_MGR_NO_INDEX) return false;
+    m->index_by_addr[d->link][slave_addr] = m->index_by_addr[d->link][d->slave_addr];
+    m->index_by_addr[d->link][d->slave_addr] = PUMP_MGR_NO_INDEX;
+
+    pumpmgr_write_begin(d);
     d->slave_addr = slave_addr;
+    pumpmgr_write_end(d);
     return true;
 }
 
@@ -107,7 +487,9 @@ bool PumpMgr_SetCtrlAddr(PumpMgr *m, uint8_t id, uint8_t ctrl_addr)
 {
     PumpDevice *d = PumpMgr_Get(m, id);
     if (d == NULL) return false;
+    pumpmgr_write_begin(d);
     d->ctrl_addr = ctrl_addr;
+    pumpmgr_write_end(d);
     return true;
 }
 
@@ -121,99 +503,284 @@ uint8_t PumpMgr_GetCtrlAddr(const PumpMgr *m, uint8_t id)
 void PumpMgr_ClearFail(PumpMgr *m, uint8_t id)
 {
     if (m == NULL) return;
-    for (uint8_t i = 0u; i < m->count; i++)
-    {
-        if (m->pumps[i].id == id)
-        {
-            m->pumps[i].last_error = 0u;
-            m->pumps[i].fail_count = 0u;
-            return;
-        }
-    }
+    uint8_t idx = pumpmgr_index_of(m, id);
+    if (idx == PUMP_MGR_NO_INDEX) return;
+
+    PumpDevice *d = &m->pumps[idx];
+    pumpmgr_write_begin(d);
+    d->last_error = 0u;
+    m->hot.fail_count[idx] = 0u;
+    m->hot.health[idx] = PUMP_HEALTH_ONLINE;
+    d->probe_backoff_ms = 0u;
+    pumpmgr_write_end(d);
 }
 
 void PumpMgr_RequestPollNow(PumpMgr *m, uint8_t id)
 {
     if (m == NULL) return;
-    uint32_t now = HAL_GetTick();
-    for (uint8_t i = 0u; i < m->count; i++)
-    {
-        if (m->pumps[i].id == id)
-        {
-            m->next_poll_ms[i] = now;
-            return;
-        }
-    }
+    uint8_t idx = pumpmgr_index_of(m, id);
+    if (idx == PUMP_MGR_NO_INDEX) return;
+    m->hot.next_poll_ms[idx] = HAL_GetTick();
+    m->hot.urgent[idx] = 1u;
 }
 
 void PumpMgr_RequestPollAllNow(PumpMgr *m)
 {
     if (m == NULL) return;
     uint32_t now = HAL_GetTick();
-    for (uint8_t i = 0u; i < m->count; i++)
+    for (uint8_t bi = 0u; bi < m->bus_count; bi++)
     {
-        m->next_poll_ms[i] = now;
+        pumpmgr_spread_phases(m, bi, now);
     }
 }
 
-PumpProtoResult PumpMgr_RequestTotalizer(PumpMgr *mgr, uint8_t pump_id, uint8_t nozzle)
+bool PumpMgr_SetNozzleCount(PumpMgr *m, uint8_t id, uint8_t count)
 {
-    if (mgr == NULL || pump_id == 0 || pump_id > PUMP_MGR_MAX_PUMPS) return PUMP_PROTO_ERR;
+    PumpDevice *d = PumpMgr_Get(m, id);
+    if (d == NULL) return false;
+    if (count < 1u || count > (uint8_t)PUMP_MGR_MAX_NOZZLES) return false;
+    d->nozzle_count = count;
+    return true;
+}
 
-    PumpDevice *dev = &mgr->pumps[pump_id - 1u];
+uint8_t PumpMgr_GetNozzleCount(const PumpMgr *m, uint8_t id)
+{
+    const PumpDevice *d = PumpMgr_GetConst(m, id);
+    if (d == NULL) return 0u;
+    return d->nozzle_count;
+}
 
-    /* Call request_totalizer if available */
-    if (dev->proto.vt && dev->proto.vt->request_totalizer)
+bool PumpMgr_GetTotalizer(const PumpMgr *m, uint8_t id, uint8_t nozzle, PumpTotalizer *out)
+{
+    if (m == NULL || out == NULL) return false;
+    uint8_t idx = pumpmgr_index_of(m, id);
+    if (idx == PUMP_MGR_NO_INDEX) return false;
+    if (nozzle < 1u || nozzle > m->pumps[idx].nozzle_count) return false;
+
+    *out = m->tot[idx][nozzle - 1u];
+    return true;
+}
+
+void PumpMgr_RefreshTotalizers(PumpMgr *m, uint8_t id)
+{
+    if (m == NULL) return;
+    for (uint8_t i = 0u; i < m->count; i++)
     {
-        return dev->proto.vt->request_totalizer(dev->proto.ctx, dev->ctrl_addr, dev->slave_addr, nozzle);
+        if (id != 0u && m->pumps[i].id != id) continue;
+        m->tot_want[i] = (uint8_t)((1u << m->pumps[i].nozzle_count) - 1u);
     }
+}
 
-    return PUMP_PROTO_ERR;
+PumpProtoResult PumpMgr_RequestTotalizer(PumpMgr *mgr, uint8_t pump_id, uint8_t nozzle)
+{
+    PumpDevice *dev = PumpMgr_Get(mgr, pump_id);
+    if (dev == NULL) return PUMP_PROTO_ERR;
+
+    return PumpProto_RequestTotalizer(&mgr->bus[dev->link].proto, dev->ctrl_addr, dev->slave_addr, nozzle);
 }
 
-static void pumpmgr_handle_event(PumpMgr *m, const PumpEvent *ev)
+static void pumpmgr_handle_event(PumpMgr *m, uint8_t link, const PumpEvent *ev)
 {
     if (m == NULL || ev == NULL) return;
 
     /* Find matching device by address */
-    for (uint8_t i = 0u; i < m->count; i++)
+    uint8_t i = pumpmgr_index_by_addr(m, link, ev->ctrl_addr, ev->slave_addr);
+    if (i == PUMP_MGR_NO_INDEX) return;
+
+    PumpDevice *d = &m->pumps[i];
+    PumpMgrNotify n;
+    memset(&n, 0, sizeof(n));
+    n.pump_id = d->id;
+
+    if (ev->type == PUMP_EVT_STATUS)
     {
-        PumpDevice *d = &m->pumps[i];
-        if (d->ctrl_addr == ev->ctrl_addr && d->slave_addr == ev->slave_addr)
+        /* OLD format - no union */
+        uint32_t now = HAL_GetTick();
+        bool changed = (m->hot.status[i] != ev->status) || (m->hot.nozzle[i] != ev->nozzle) ||
+                       (d->last_status_ms == 0u);
+        bool recovered = (m->hot.health[i] == PUMP_HEALTH_QUARANTINED);
+
+        n.prev_status = m->hot.status[i];
+
+        pumpmgr_write_begin(d);
+        m->hot.status[i] = ev->status;
+        m->hot.nozzle[i] = ev->nozzle;
+        d->last_status_ms = now;
+        d->last_seen_ms = now;
+        if ((ev->status >= 2u && ev->status < 8u) || (changed && n.prev_status <= 1u && ev->status > 1u))
         {
-            if (ev->type == PUMP_EVT_STATUS)
-            {
-                /* OLD format - no union */
-                d->status = ev->status;
-                d->nozzle = ev->nozzle;
-                d->last_status_ms = HAL_GetTick();
-                d->last_error = 0u;
-                d->fail_count = 0u;
-            }
-            else if (ev->type == PUMP_EVT_ERROR)
-            {
-                /* OLD format - no union */
-                d->last_error = ev->error_code;
-                d->fail_count = ev->fail_count;
-            }
-            else if (ev->type == PUMP_EVT_TOTALIZER)
+            d->last_flow_ms = now;
+        }
+        d->last_error = 0u;
+        m->hot.fail_count[i] = 0u;
+        m->hot.health[i] = PUMP_HEALTH_ONLINE;
+        d->probe_backoff_ms = 0u;
+        pumpmgr_write_end(d);
+
+        if (recovered)
+        {
+            char msg[40];
+            (void)snprintf(msg, sizeof(msg), "PumpMgr: pump %u online", (unsigned)d->id);
+            CDC_Log(msg);
+            m->hot.next_poll_ms[i] = now + pumpmgr_poll_period(m, i);
+        }
+        pumpmgr_reschedule(m, i, now);
+
+        /* Price job: an idle pump is a safe point to switch at */
+        if (m->price_job.state == PUMP_PRICE_JOB_PENDING && ev->status <= 1u)
+        {
+            m->price_job.confirmed[i] = 1u;
+        }
+
+        /* Sale over (back to idle after delivery): totalizers moved. Readings
+           taken after the flow stopped (e.g. the FSM's read after S8) are
+           already final and stay; they are the next sale's starting point. */
+        if (changed && ev->status <= 1u && n.prev_status >= 4u)
+        {
+            for (uint8_t k = 0u; k < d->nozzle_count; k++)
             {
-                /* Log totalizer event */
-                CDC_Log("PumpMgr: Totalizer event");
+                PumpTotalizer *t = &m->tot[i][k];
+                if (t->valid && (int32_t)(t->stamp_ms - d->last_flow_ms) > 0) continue;
+                memset(t, 0, sizeof(*t));
+                m->tot_want[i] |= (uint8_t)(1u << k);
             }
         }
+
+        if (changed)
+        {
+            n.what = PUMP_MGR_NOTIFY_STATUS;
+            n.status = ev->status;
+            n.nozzle = ev->nozzle;
+            pumpmgr_notify(m, &n);
+        }
+    }
+    else if (ev->type == PUMP_EVT_ALIVE)
+    {
+        /* Reply to a non-status command: the pump is alive, so the next
+           'S' poll is pushed back by one period instead of piling on top */
+        uint32_t now = HAL_GetTick();
+        bool recovered = (m->hot.health[i] == PUMP_HEALTH_QUARANTINED);
+
+        pumpmgr_write_begin(d);
+        d->last_seen_ms = now;
+        d->last_error = 0u;
+        m->hot.fail_count[i] = 0u;
+        m->hot.health[i] = PUMP_HEALTH_ONLINE;
+        d->probe_backoff_ms = 0u;
+        pumpmgr_write_end(d);
+
+        if (recovered)
+        {
+            char msg[40];
+            (void)snprintf(msg, sizeof(msg), "PumpMgr: pump %u online", (unsigned)d->id);
+            CDC_Log(msg);
+        }
+
+        if (m->hot.urgent[i] == 0u)
+        {
+            uint32_t next = now + pumpmgr_poll_period(m, i);
+            if ((int32_t)(next - m->hot.next_poll_ms[i]) > 0) m->hot.next_poll_ms[i] = next;
+        }
+
+        n.what = PUMP_MGR_NOTIFY_REPLY;
+        n.cmd = ev->cmd;
+        n.nozzle_idx = ev->nozzle_idx;
+        n.value = ev->value;
+        pumpmgr_notify(m, &n);
+    }
+    else if (ev->type == PUMP_EVT_ERROR)
+    {
+        /* OLD format - no union. ev->fail_count counts the whole link,
+           so failures are counted per pump here. */
+        uint8_t fails = (m->hot.fail_count[i] < 255u) ? (uint8_t)(m->hot.fail_count[i] + 1u) : 255u;
+        bool enter = (m->hot.health[i] == PUMP_HEALTH_ONLINE) && (fails >= (uint8_t)PUMP_MGR_OFFLINE_FAILS);
+
+        pumpmgr_write_begin(d);
+        d->last_error = ev->error_code;
+        m->hot.fail_count[i] = fails;
+        if (enter)
+        {
+            m->hot.health[i] = PUMP_HEALTH_QUARANTINED;
+            d->probe_backoff_ms = m->poll_offline_ms;
+            d->quarantine_count++;
+        }
+        else if (m->hot.health[i] == PUMP_HEALTH_QUARANTINED)
+        {
+            /* Failed probe: back off further */
+            uint32_t next = d->probe_backoff_ms * 2u;
+            d->probe_backoff_ms = (next > (uint32_t)PUMP_MGR_PROBE_MAX_MS) ? (uint32_t)PUMP_MGR_PROBE_MAX_MS : next;
+        }
+        pumpmgr_write_end(d);
+
+        if (m->hot.health[i] == PUMP_HEALTH_QUARANTINED)
+        {
+            m->hot.next_poll_ms[i] = HAL_GetTick() + d->probe_backoff_ms;
+        }
+        if (enter)
+        {
+            /* Unreachable pump cannot authorise: don't hold a price job for it */
+            m->price_job.confirmed[i] = 1u;
+
+            char msg[48];
+            (void)snprintf(msg, sizeof(msg), "PumpMgr: pump %u quarantined", (unsigned)d->id);
+            CDC_Log(msg);
+        }
+
+        n.what = PUMP_MGR_NOTIFY_FAIL;
+        n.error_code = ev->error_code;
+        n.fail_count = fails;
+        pumpmgr_notify(m, &n);
+    }
+    else if (ev->type == PUMP_EVT_TOTALIZER)
+    {
+        if (ev->nozzle_idx < 1u || ev->nozzle_idx > (uint8_t)PUMP_MGR_MAX_NOZZLES) return;
+
+        PumpTotalizer *t = &m->tot[i][ev->nozzle_idx - 1u];
+        bool changed = (t->valid == 0u) || (t->value != ev->totalizer);
+
+        t->value = ev->totalizer;
+        t->stamp_ms = HAL_GetTick();
+        t->valid = 1u;
+        m->tot_want[i] &= (uint8_t)~(1u << (ev->nozzle_idx - 1u));
+
+        if (changed)
+        {
+            char msg[56];
+            (void)snprintf(msg, sizeof(msg), "PumpMgr: pump %u tot%u=%lu",
+                           (unsigned)d->id, (unsigned)ev->nozzle_idx, (unsigned long)ev->totalizer);
+            CDC_Log(msg);
+
+            n.what = PUMP_MGR_NOTIFY_TOTALIZER;
+            n.nozzle_idx = ev->nozzle_idx;
+            n.totalizer = ev->totalizer;
+            pumpmgr_notify(m, &n);
+        }
     }
 }
 
+void PumpMgr_PutTotalizer(PumpMgr *m, uint8_t id, uint8_t nozzle, uint32_t value)
+{
+    const PumpDevice *d = PumpMgr_GetConst(m, id);
+    if (d == NULL) return;
+
+    PumpEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = PUMP_EVT_TOTALIZER;
+    ev.ctrl_addr = d->ctrl_addr;
+    ev.slave_addr = d->slave_addr;
+    ev.nozzle_idx = nozzle;
+    ev.totalizer = value;
+    pumpmgr_handle_event(m, d->link, &ev);
+}
+
 bool PumpMgr_PopEvent(PumpMgr *m, PumpEvent *out)
 {
     if (m == NULL || out == NULL) return false;
 
-    /* Try each pump's protocol */
-    for (uint8_t i = 0u; i < m->count; i++)
+    /* Try each bus protocol */
+    for (uint8_t i = 0u; i < m->bus_count; i++)
     {
-        PumpDevice *d = &m->pumps[i];
-        if (PumpProto_PopEvent(&d->proto, out))
+        if (PumpProto_PopEvent(&m->bus[i].proto, out))
         {
             return true;
         }
@@ -222,60 +789,165 @@ bool PumpMgr_PopEvent(PumpMgr *m, PumpEvent *out)
     return false;
 }
 
-void PumpMgr_Task(PumpMgr *m)
+/* Close a utilisation window and let the governor react */
+static uint16_t pumpmgr_permille(uint32_t part, uint32_t whole)
 {
-    if (m == NULL) return;
-    uint32_t now = HAL_GetTick();
+    if (whole == 0u) return 0u;
+    uint32_t v = (part * 1000u) / whole;
+    return (v > 1000u) ? 1000u : (uint16_t)v;
+}
 
-    /* Build unique protocol list */
-    PumpProto *protos[PUMP_MGR_MAX_PUMPS];
-    uint8_t proto_count = 0u;
-    for (uint8_t i = 0u; i < m->count; i++)
+static void pumpmgr_update_util(PumpMgr *m, uint8_t bi, uint32_t now)
+{
+    PumpMgrBus *b = &m->bus[bi];
+    uint32_t elapsed = now - b->win_start_ms;
+    if (elapsed < (uint32_t)PUMP_MGR_UTIL_WINDOW_MS) return;
+
+    PumpBusTime t;
+    if (!PumpProto_GetBusTime(&b->proto, &t)) return;
+
+    b->tx_permille = pumpmgr_permille(t.tx_ms - b->win_start.tx_ms, elapsed);
+    b->wait_permille = pumpmgr_permille(t.wait_ms - b->win_start.wait_ms, elapsed);
+    b->rx_permille = pumpmgr_permille(t.rx_ms - b->win_start.rx_ms, elapsed);
+
+    uint32_t busy = (uint32_t)b->tx_permille + b->wait_permille + b->rx_permille;
+    if (busy > 1000u) busy = 1000u;
+
+    /* Smooth over ~4 windows */
+    b->util_permille = (uint16_t)(((uint32_t)b->util_permille * 3u + busy) / 4u);
+
+    b->win_start = t;
+    b->win_start_ms = now;
+
+    /* Governor: double the stretch while above target, halve it once
+       comfortably below */
+    uint8_t stretch = b->stretch;
+    if (b->util_permille > m->util_target_permille)
+    {
+        if (stretch < (uint8_t)PUMP_MGR_STRETCH_MAX) stretch = (uint8_t)(stretch * 2u);
+    }
+    else if ((uint32_t)b->util_permille + PUMP_MGR_UTIL_HYST_PERMILLE < m->util_target_permille)
+    {
+        if (stretch > 1u) stretch = (uint8_t)(stretch / 2u);
+    }
+
+    if (stretch != b->stretch)
+    {
+        b->stretch = stretch;
+        char msg[56];
+        (void)snprintf(msg, sizeof(msg), "PumpMgr: bus %u util %u%% stretch x%u",
+                       (unsigned)bi, (unsigned)(b->util_permille / 10u), (unsigned)stretch);
+        CDC_Log(msg);
+    }
+}
+
+/* Earliest-deadline-first pick among due pumps of one bus:
+   an urgent one (PumpMgr_RequestPollNow) first, else the oldest deadline. */
+static uint8_t pumpmgr_pick_due(const PumpMgr *m, const PumpMgrBus *b, uint32_t now)
+{
+    uint8_t best = PUMP_MGR_NO_INDEX;
+
+    for (uint8_t k = 0u; k < b->dev_count; k++)
     {
-        PumpProto *p = &m->pumps[i].proto;
+        uint8_t i = b->dev[k];
+        if (!pumpmgr_is_due(now, m->hot.next_poll_ms[i])) continue;
 
-        bool seen = false;
-        for (uint8_t j = 0u; j < proto_count; j++)
+        if (best == PUMP_MGR_NO_INDEX)
         {
-            if (protos[j] == p)
-            {
-                seen = true;
-                break;
-            }
+            best = i;
         }
-
-        if (!seen && proto_count < (uint8_t)PUMP_MGR_MAX_PUMPS)
+        else if (m->hot.urgent[i] != m->hot.urgent[best])
+        {
+            if (m->hot.urgent[i]) best = i;
+        }
+        else if ((int32_t)(m->hot.next_poll_ms[i] - m->hot.next_poll_ms[best]) < 0)
         {
-            protos[proto_count++] = p;
+            best = i;
         }
     }
+    return best;
+}
 
-    /* 1) Drive protocols and consume their events */
-    for (uint8_t i = 0u; i < proto_count; i++)
+/* Totalizer refresh in an idle bus slot. Requested entries go first; stale
+   ones only while the pump is idle and the governor is not stretching the
+   bus. Reads are spaced by PUMP_MGR_TOT_GAP_MS, so they never come in bursts. */
+static void pumpmgr_refresh_totalizer(PumpMgr *m, PumpMgrBus *b, uint32_t now)
+{
+    if (!pumpmgr_is_due(now, b->tot_next_ms)) return;
+
+    uint16_t total = (uint16_t)(b->dev_count * PUMP_MGR_MAX_NOZZLES);
+    if (total == 0u) return;
+
+    for (uint8_t pass = 0u; pass < 2u; pass++)
     {
-        PumpProto *p = protos[i];
-        PumpProto_Task(p);
+        if (pass == 1u && b->stretch > 1u) return;
 
-        PumpEvent ev;
-        while (PumpProto_PopEvent(p, &ev))
+        for (uint16_t step = 0u; step < total; step++)
         {
-            pumpmgr_handle_event(m, &ev);
+            uint16_t pos = (uint16_t)((b->tot_cursor + step) % total);
+            uint8_t i = b->dev[pos / PUMP_MGR_MAX_NOZZLES];
+            uint8_t n = (uint8_t)(pos % PUMP_MGR_MAX_NOZZLES);
+            const PumpDevice *d = &m->pumps[i];
+
+            if (n >= d->nozzle_count || m->hot.health[i] != PUMP_HEALTH_ONLINE) continue;
+
+            if (pass == 0u)
+            {
+                if ((m->tot_want[i] & (1u << n)) == 0u) continue;
+            }
+            else
+            {
+                const PumpTotalizer *t = &m->tot[i][n];
+                if (m->hot.status[i] > 1u || d->last_status_ms == 0u) continue;
+                if (t->valid && (now - t->stamp_ms) < (uint32_t)PUMP_MGR_TOT_MAX_AGE_MS) continue;
+            }
+
+            if (PumpProto_RequestTotalizer(&b->proto, d->ctrl_addr, d->slave_addr, (uint8_t)(n + 1u)) == PUMP_PROTO_OK)
+            {
+                b->tot_cursor = (uint16_t)((pos + 1u) % total);
+                b->tot_next_ms = now + PUMP_MGR_TOT_GAP_MS;
+            }
+            return;
         }
     }
+}
 
-    /* 2) Periodic polling */
-    for (uint8_t i = 0u; i < m->count; i++)
+void PumpMgr_Task(PumpMgr *m)
+{
+    if (m == NULL) return;
+    uint32_t now = HAL_GetTick();
+
+    pumpmgr_price_job_task(m, now);
+
+    for (uint8_t bi = 0u; bi < m->bus_count; bi++)
     {
-        PumpDevice *d = &m->pumps[i];
+        PumpMgrBus *b = &m->bus[bi];
+
+        /* 1) Drive the link and consume its events */
+        PumpProto_Task(&b->proto);
+
+        PumpEvent ev;
+        while (PumpProto_PopEvent(&b->proto, &ev))
+        {
+            pumpmgr_handle_event(m, bi, &ev);
+        }
+
+        pumpmgr_update_util(m, bi, now);
 
-        if (now < m->next_poll_ms[i]) continue;
+        /* 2) One request in flight per link: poll the most pressing due pump */
+        if (!PumpProto_IsIdle(&b->proto)) continue;
 
-        if (!PumpProto_IsIdle(&d->proto))
+        uint8_t idx = pumpmgr_pick_due(m, b, now);
+        if (idx == PUMP_MGR_NO_INDEX)
         {
+            /* 3) Nothing due: use the slot for the totalizer cache */
+            pumpmgr_refresh_totalizer(m, b, now);
             continue;
         }
 
-        (void)PumpProto_PollStatus(&d->proto, d->ctrl_addr, d->slave_addr);
-        m->next_poll_ms[i] = now + m->poll_period_ms;
+        PumpDevice *d = &m->pumps[idx];
+        (void)PumpProto_PollStatus(&b->proto, d->ctrl_addr, d->slave_addr);
+        m->hot.next_poll_ms[idx] = now + pumpmgr_poll_period(m, idx);
+        m->hot.urgent[idx] = 0u;
     }
 }
@@ -8,6 +8,7 @@
 /* USER CODE END Header */
 
 #include "pump_proto_gkl.h"
+#include "pump_response_parser.h"
 
 #include "cdc_logger.h"
 
@@ -211,6 +212,78 @@ static void gkl_log_line(PumpProtoGKL *gkl, const char *line)
 #endif
 }
 
+/* RX frame trace (compact or verbose, per build options) */
+static void gkl_log_rx(PumpProtoGKL *gkl, const GKL_Frame *fr)
+{
+#if (PUMP_GKL_COMPACT_LOG == 1)
+    /* Compact format: <STX><NUL><SOH>SR (like reference log) */
+    uint8_t raw[GKL_MAX_FRAME_LEN];
+    uint8_t raw_len = 0u;
+    raw[0] = GKL_STX;
+    raw[1] = fr->ctrl;
+    raw[2] = fr->slave;
+    raw[3] = (uint8_t)fr->cmd;
+    for (uint8_t i = 0u; i < fr->data_len; i++)
+    {
+        raw[4u + i] = fr->data[i];
+    }
+    raw_len = (uint8_t)(5u + fr->data_len);
+    uint8_t c = 0u;
+    for (uint8_t i = 1u; i < (uint8_t)(raw_len - 1u); i++) c ^= raw[i];
+    raw[raw_len - 1u] = c;
+
+    char line[64];
+    gkl_format_frame_compact(raw, raw_len, line, sizeof(line));
+    strcat(line, "\r\n");
+    gkl_log_line(gkl, line);
+#else
+    /* Verbose format */
+#if (PUMP_GKL_TRACE_FRAMES)
+    uint8_t raw[GKL_MAX_FRAME_LEN];
+    uint8_t raw_len = 0u;
+    raw[0] = GKL_STX;
+    raw[1] = fr->ctrl;
+    raw[2] = fr->slave;
+    raw[3] = (uint8_t)fr->cmd;
+    for (uint8_t i = 0u; i < fr->data_len; i++)
+    {
+        raw[4u + i] = fr->data[i];
+    }
+    raw_len = (uint8_t)(5u + fr->data_len);
+    uint8_t c = 0u;
+    for (uint8_t i = 1u; i < (uint8_t)(raw_len - 1u); i++) c ^= raw[i];
+    raw[raw_len - 1u] = c;
+
+    char fstr[240];
+    gkl_format_frame_bytes(raw, raw_len, fstr, sizeof(fstr));
+    char l[300];
+    char hstr[240];
+    gkl_format_hex_bytes(raw, raw_len, hstr, sizeof(hstr));
+    (void)snprintf(l, sizeof(l), "RX %s | HEX: %s\r\n", fstr, hstr);
+    gkl_log_line(gkl, l);
+#else
+    (void)gkl;
+    (void)fr;
+#endif
+#endif
+}
+
+/* Good exchange: re-arm error reporting, so a later failure with the
+   same (error, fail count) pair is not mistaken for a repeat */
+static void gkl_link_ok(PumpProtoGKL *gkl)
+{
+    gkl->last_reported_err = GKL_OK;
+    gkl->last_reported_failcnt = 0u;
+
+    if (gkl->no_connect_latched)
+    {
+        gkl->no_connect_latched = 0u;
+#if (PUMP_GKL_COMPACT_LOG == 0)
+        gkl_log_line(gkl, "LINK OK\r\n");
+#endif
+    }
+}
+
 /* ===================== PumpProto vtable implementation ===================== */
 
 static void gkl_task(void *ctx)
@@ -258,144 +331,83 @@ static void gkl_task(void *ctx)
 
     GKL_Task(&gkl->link);
 
-    if (GKL_HasResponse(&gkl->link))
+    /* Frames matching no request (late replies, bus noise that framed):
+       counted by the link, never taken as an answer */
+    GKL_Frame fr;
+    if (GKL_GetUnsolicited(&gkl->link, &fr))
     {
-        GKL_Frame fr;
-        if (GKL_GetResponse(&gkl->link, &fr))
-        {
-#if (PUMP_GKL_COMPACT_LOG == 1)
-            /* Compact format: <STX><NUL><SOH>SR (like reference log) */
-            uint8_t raw[GKL_MAX_FRAME_LEN];
-            uint8_t raw_len = 0u;
-            raw[0] = GKL_STX;
-            raw[1] = fr.ctrl;
-            raw[2] = fr.slave;
-            raw[3] = (uint8_t)fr.cmd;
-            for (uint8_t i = 0u; i < fr.data_len; i++)
-            {
-                raw[4u + i] = fr.data[i];
-            }
-            raw_len = (uint8_t)(5u + fr.data_len);
-            uint8_t c = 0u;
-            for (uint8_t i = 1u; i < (uint8_t)(raw_len - 1u); i++) c ^= raw[i];
-            raw[raw_len - 1u] = c;
-
-            char line[64];
-            gkl_format_frame_compact(raw, raw_len, line, sizeof(line));
-            strcat(line, "\r\n");
-            gkl_log_line(gkl, line);
-#else
-            /* Verbose format */
-#if (PUMP_GKL_TRACE_FRAMES)
-            uint8_t raw[GKL_MAX_FRAME_LEN];
-            uint8_t raw_len = 0u;
-            raw[0] = GKL_STX;
-            raw[1] = fr.ctrl;
-            raw[2] = fr.slave;
-            raw[3] = (uint8_t)fr.cmd;
-            for (uint8_t i = 0u; i < fr.data_len; i++)
-            {
-                raw[4u + i] = fr.data[i];
-            }
-            raw_len = (uint8_t)(5u + fr.data_len);
-            uint8_t c = 0u;
-            for (uint8_t i = 1u; i < (uint8_t)(raw_len - 1u); i++) c ^= raw[i];
-            raw[raw_len - 1u] = c;
-
-            char fstr[240];
-            gkl_format_frame_bytes(raw, raw_len, fstr, sizeof(fstr));
-            char l[300];
-            char hstr[240];
-            gkl_format_hex_bytes(raw, raw_len, hstr, sizeof(hstr));
-            (void)snprintf(l, sizeof(l), "RX %s | HEX: %s\r\n", fstr, hstr);
-            gkl_log_line(gkl, l);
-#endif
-#endif
-
-            if (gkl->no_connect_latched)
-            {
-                gkl->no_connect_latched = 0u;
 #if (PUMP_GKL_COMPACT_LOG == 0)
-                gkl_log_line(gkl, "LINK OK\r\n");
+        char l[48];
+        (void)snprintf(l, sizeof(l), "UNSOLICITED %c from %u\r\n", fr.cmd, (unsigned)fr.slave);
+        gkl_log_line(gkl, l);
 #endif
-            }
+    }
 
-            if (fr.cmd == 'S' && fr.data_len >= 2u)
-            {
-                uint8_t st = fr.data[0];
-                uint8_t noz = fr.data[1];
-
-                if (st >= (uint8_t)'0' && st <= (uint8_t)'9') st -= (uint8_t)'0';
-                if (noz >= (uint8_t)'0' && noz <= (uint8_t)'9') noz -= (uint8_t)'0';
-
-                PumpEvent ev;
-                memset(&ev, 0, sizeof(ev));
-                ev.type = PUMP_EVT_STATUS;
-                ev.ctrl_addr = fr.ctrl;
-                ev.slave_addr = fr.slave;
-                ev.status = st;
-                ev.nozzle = noz;
-                q_push(gkl, &ev);
-            }
-            else if (fr.cmd == 'C' && fr.data_len >= 10u)
-            {
-                uint8_t nozzle = 0;
-                uint32_t totalizer = 0;
-
-                if (fr.data[0] >= '1' && fr.data[0] <= '6')
-                {
-                    nozzle = (uint8_t)(fr.data[0] - '0');
-                }
-
-                for (uint8_t i = 2; i < 11 && i < fr.data_len; i++)
-                {
-                    if (fr.data[i] >= '0' && fr.data[i] <= '9')
-                    {
-                        totalizer = totalizer * 10 + (fr.data[i] - '0');
-                    }
-                }
-
-                PumpEvent ev;
-                memset(&ev, 0, sizeof(ev));
-                ev.type = PUMP_EVT_TOTALIZER;
-                ev.ctrl_addr = fr.ctrl;
-                ev.slave_addr = fr.slave;
-                ev.nozzle_idx = nozzle;
-                ev.totalizer = totalizer;
-
-                q_push(gkl, &ev);
-            }
+    /* Our own 'S'/'C' request finished */
+    if (gkl->done.done == 0u) return;
+    gkl->done.done = 0u;
+
+    if (gkl->done.result == GKL_OK)
+    {
+        fr = gkl->done.frame;
+        gkl_log_rx(gkl, &fr);
+        gkl_link_ok(gkl);
+
+        if (fr.cmd == 'S' && fr.data_len >= 2u)
+        {
+            uint8_t st = fr.data[0];
+            uint8_t noz = fr.data[1];
+
+            if (st >= (uint8_t)'0' && st <= (uint8_t)'9') st -= (uint8_t)'0';
+            if (noz >= (uint8_t)'0' && noz <= (uint8_t)'9') noz -= (uint8_t)'0';
+
+            PumpEvent ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.type = PUMP_EVT_STATUS;
+            ev.ctrl_addr = fr.ctrl;
+            ev.slave_addr = fr.slave;
+            ev.status = st;
+            ev.nozzle = noz;
+            q_push(gkl, &ev);
+        }
+        else if (fr.cmd == 'C' && fr.data_len >= 10u)
+        {
+            uint8_t nozzle = 0;
+            uint32_t totalizer = 0;
+            (void)PumpResp_ParseTotalizer(&fr, &nozzle, &totalizer);
+
+            PumpEvent ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.type = PUMP_EVT_TOTALIZER;
+            ev.ctrl_addr = fr.ctrl;
+            ev.slave_addr = fr.slave;
+            ev.nozzle_idx = nozzle;
+            ev.totalizer = totalizer;
+
+            q_push(gkl, &ev);
         }
-        gkl->pending = 0u;
         return;
     }
 
-    if (gkl->pending)
-    {
-        GKL_Stats st = GKL_GetStats(&gkl->link);
-        if (st.last_error != GKL_OK)
-        {
-            maybe_report_error(gkl);
+    GKL_Stats st = GKL_GetStats(&gkl->link);
+    maybe_report_error(gkl);
 
-            if ((st.consecutive_fail >= (uint8_t)PUMP_GKL_NO_CONNECT_THRESHOLD) && (gkl->no_connect_latched == 0u))
-            {
-                gkl->no_connect_latched = 1u;
+    if ((st.consecutive_fail >= (uint8_t)PUMP_GKL_NO_CONNECT_THRESHOLD) && (gkl->no_connect_latched == 0u))
+    {
+        gkl->no_connect_latched = 1u;
 #if (PUMP_GKL_COMPACT_LOG == 0)
-                char l[128];
-                (void)snprintf(l, sizeof(l),
-                               "No Connect!! fail=%u err=%s rx=%u len=%u last=0x%02X tot=%lu/%lu\r\n",
-                               (unsigned)st.consecutive_fail,
-                               gkl_err_str(st.last_error),
-                               (unsigned)st.rx_seen_since_tx,
-                               (unsigned)st.rx_len,
-                               (unsigned)st.last_rx_byte,
-                               (unsigned long)st.rx_total_bytes,
-                               (unsigned long)st.rx_total_frames);
-                gkl_log_line(gkl, l);
+        char l[128];
+        (void)snprintf(l, sizeof(l),
+                       "No Connect!! fail=%u err=%s rx=%u len=%u last=0x%02X tot=%lu/%lu\r\n",
+                       (unsigned)st.consecutive_fail,
+                       gkl_err_str(st.last_error),
+                       (unsigned)st.rx_seen_since_tx,
+                       (unsigned)st.rx_len,
+                       (unsigned)st.last_rx_byte,
+                       (unsigned long)st.rx_total_bytes,
+                       (unsigned long)st.rx_total_frames);
+        gkl_log_line(gkl, l);
 #endif
-            }
-            gkl->pending = 0u;
-        }
     }
 }
 
@@ -403,7 +415,8 @@ static bool gkl_is_idle(void *ctx)
 {
     PumpProtoGKL *gkl = (PumpProtoGKL*)ctx;
     if (gkl == NULL) return false;
-    return (GKL_GetStats(&gkl->link).state == GKL_STATE_IDLE);
+    /* Hot path (every manager pass): read the state, not a full stats copy */
+    return (gkl->link.state == GKL_STATE_IDLE);
 }
 
 static PumpProtoResult gkl_send_poll_status(void *ctx, uint8_t ctrl_addr, uint8_t slave_addr)
@@ -411,7 +424,7 @@ static PumpProtoResult gkl_send_poll_status(void *ctx, uint8_t ctrl_addr, uint8_
     PumpProtoGKL *gkl = (PumpProtoGKL *)ctx;
     if (gkl == NULL) return PUMP_PROTO_ERR;
 
-    GKL_Result r = GKL_Send(&gkl->link, ctrl_addr, slave_addr, 'S', NULL, 0u, 'S');
+    GKL_Result r = GKL_SendEx(&gkl->link, ctrl_addr, slave_addr, 'S', NULL, 0u, 'S', &gkl->done);
     if (r == GKL_ERR_BUSY) return PUMP_PROTO_BUSY;
     if (r != GKL_OK) return PUMP_PROTO_ERR;
 
@@ -442,7 +455,6 @@ static PumpProtoResult gkl_send_poll_status(void *ctx, uint8_t ctrl_addr, uint8_
 #endif
 #endif
 
-    gkl->pending = 1u;
     gkl->pending_ctrl = ctrl_addr;
     gkl->pending_slave = slave_addr;
 
@@ -462,7 +474,7 @@ static PumpProtoResult gkl_request_totalizer(void *ctx, uint8_t ctrl_addr, uint8
     uint8_t data[1];
     data[0] = (uint8_t)('0' + nozzle);
 
-    GKL_Result r = GKL_Send(&gkl->link, ctrl_addr, slave_addr, 'C', data, 1u, 'C');
+    GKL_Result r = GKL_SendEx(&gkl->link, ctrl_addr, slave_addr, 'C', data, 1u, 'C', &gkl->done);
     if (r == GKL_ERR_BUSY) return PUMP_PROTO_BUSY;
     if (r != GKL_OK) return PUMP_PROTO_ERR;
 
@@ -493,7 +505,6 @@ static PumpProtoResult gkl_request_totalizer(void *ctx, uint8_t ctrl_addr, uint8
 #endif
 #endif
 
-    gkl->pending = 1u;
     gkl->pending_ctrl = ctrl_addr;
     gkl->pending_slave = slave_addr;
 
@@ -506,12 +517,26 @@ static bool gkl_pop_event(void *ctx, PumpEvent *out)
     return q_pop(gkl, out);
 }
 
+static bool gkl_get_bus_time(void *ctx, PumpBusTime *out)
+{
+    PumpProtoGKL *gkl = (PumpProtoGKL*)ctx;
+    if (gkl == NULL || out == NULL) return false;
+
+    GKL_Stats st = GKL_GetStats(&gkl->link);
+    out->tx_ms = st.time_tx_ms;
+    out->wait_ms = st.time_wait_ms;
+    out->rx_ms = st.time_rx_ms;
+    out->exchanges = st.exchanges;
+    return true;
+}
+
 static const PumpProtoVTable s_vt = {
     .task               = gkl_task,
     .is_idle            = gkl_is_idle,
     .send_poll_status   = gkl_send_poll_status,
     .request_totalizer  = gkl_request_totalizer,
-    .pop_event          = gkl_pop_event
+    .pop_event          = gkl_pop_event,
+    .get_bus_time       = gkl_get_bus_time
 };
 
 /* ===================== Public API ===================== */
@@ -522,7 +547,6 @@ void PumpProtoGKL_Init(PumpProtoGKL *gkl, UART_HandleTypeDef *huart)
     memset(gkl, 0, sizeof(*gkl));
     gkl->q_head = 0u;
     gkl->q_tail = 0u;
-    gkl->pending = 0u;
     gkl->pending_ctrl = 0u;
     gkl->pending_slave = 0u;
     gkl->last_reported_err = GKL_OK;
@@ -534,6 +558,31 @@ void PumpProtoGKL_Init(PumpProtoGKL *gkl, UART_HandleTypeDef *huart)
     GKL_Init(&gkl->link, huart);
 }
 
+void PumpProtoGKL_ReportReply(PumpProtoGKL *gkl, const GKL_Frame *fr)
+{
+    if (gkl == NULL || fr == NULL) return;
+
+    gkl_log_rx(gkl, fr);
+    gkl_link_ok(gkl);
+
+    /* Any reply proves the slave alive; 'S' replies are STATUS events instead */
+    if (fr->cmd == 'S') return;
+
+    PumpEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = PUMP_EVT_ALIVE;
+    ev.ctrl_addr = fr->ctrl;
+    ev.slave_addr = fr->slave;
+    ev.cmd = (uint8_t)fr->cmd;
+
+    uint8_t noz = 0u;
+    if (fr->cmd == 'L') (void)PumpResp_ParseRealtimeVolume(fr, &noz, &ev.value);
+    else if (fr->cmd == 'R') (void)PumpResp_ParseRealtimeMoney(fr, &noz, &ev.value);
+    ev.nozzle_idx = noz;
+
+    q_push(gkl, &ev);
+}
+
 void PumpProtoGKL_SetTag(PumpProtoGKL *gkl, const char *tag)
 {
     if (gkl == NULL) return;
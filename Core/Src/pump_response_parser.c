@@ -1,5 +1,6 @@
 /* pump_response_parser.c */
 #include "pump_response_parser.h"
+#include "fixed_dec.h"
 #include <string.h>
 
 /* Helper: Convert BCD to uint32 */
@@ -12,16 +13,6 @@ static uint32_t bcd_to_uint32(const uint8_t *bcd, uint8_t len)
     return val;
 }
 
-/* Helper: Convert BCD to uint16 */
-static uint16_t bcd_to_uint16(const uint8_t *bcd, uint8_t len)
-{
-    uint16_t val = 0;
-    for (uint8_t i = 0; i < len; i++) {
-        val = val * 100 + ((bcd[i] >> 4) * 10 + (bcd[i] & 0x0F));
-    }
-    return val;
-}
-
 /* Parse L response: 
    Format: <nozzle(1)><volume_cL(4 BCD)> = 5 bytes */
 bool PumpResp_ParseRealtimeVolume(const GKL_Frame *resp, uint8_t *nozzle, uint32_t *volume_dL)
@@ -31,7 +22,7 @@ bool PumpResp_ParseRealtimeVolume(const GKL_Frame *resp, uint8_t *nozzle, uint32
     
     *nozzle = resp->data[0];
     uint32_t volume_cL = bcd_to_uint32(&resp->data[1], 4);
-    *volume_dL = volume_cL / 10;  /* Convert cL to dL */
+    *volume_dL = FixDec_CLToDL(volume_cL, FIXDEC_VOLUME_ROUND);
     
     return true;
 }
@@ -49,16 +40,23 @@ bool PumpResp_ParseRealtimeMoney(const GKL_Frame *resp, uint8_t *nozzle, uint32_
     return true;
 }
 
-/* Parse C response:
-   Format: <nozzle(1)><totalizer_cL(5 BCD)> = 6 bytes */
-bool PumpResp_ParseTotalizer(const GKL_Frame *resp, uint8_t *nozzle, uint32_t *totalizer_dL)
+/* Parse C response (ASCII, as the pumps send it):
+   Format: <nozzle '1'..'6'><sep><totalizer_cL, 9 digits> = 11 bytes.
+   Nozzle is 0 when the byte is not a nozzle digit. */
+bool PumpResp_ParseTotalizer(const GKL_Frame *resp, uint8_t *nozzle, uint32_t *totalizer_cL)
 {
-    if (!resp || !nozzle || !totalizer_dL) return false;
-    if (resp->cmd != 'C' || resp->data_len < 6) return false;
+    if (!resp || !nozzle || !totalizer_cL) return false;
+    if (resp->cmd != 'C' || resp->data_len < 10) return false;
     
-    *nozzle = resp->data[0];
-    uint32_t totalizer_cL = bcd_to_uint32(&resp->data[1], 5);
-    *totalizer_dL = totalizer_cL / 10;  /* Convert cL to dL */
+    *nozzle = (resp->data[0] >= '1' && resp->data[0] <= '6') ? (uint8_t)(resp->data[0] - '0') : 0u;
+    
+    uint32_t tot = 0;
+    for (uint8_t i = 2; i < 11 && i < resp->data_len; i++) {
+        if (resp->data[i] >= '0' && resp->data[i] <= '9') {
+            tot = tot * 10 + (uint32_t)(resp->data[i] - '0');
+        }
+    }
+    *totalizer_cL = tot;
     
     return true;
 }
@@ -66,16 +64,16 @@ bool PumpResp_ParseTotalizer(const GKL_Frame *resp, uint8_t *nozzle, uint32_t *t
 /* Parse T response:
    Format: <nozzle(1)><volume_cL(4 BCD)><money(4 BCD)><price(2 BCD)> = 11 bytes */
 bool PumpResp_ParseTransaction(const GKL_Frame *resp, uint8_t *nozzle,
-                                uint32_t *volume_dL, uint32_t *money, uint16_t *price)
+                                uint32_t *volume_dL, uint32_t *money, uint32_t *price)
 {
     if (!resp || !nozzle || !volume_dL || !money || !price) return false;
     if (resp->cmd != 'T' || resp->data_len < 11) return false;
     
     *nozzle = resp->data[0];
     uint32_t volume_cL = bcd_to_uint32(&resp->data[1], 4);
-    *volume_dL = volume_cL / 10;
+    *volume_dL = FixDec_CLToDL(volume_cL, FIXDEC_VOLUME_ROUND);
     *money = bcd_to_uint32(&resp->data[5], 4);
-    *price = bcd_to_uint16(&resp->data[9], 2);
+    *price = bcd_to_uint32(&resp->data[9], 2);
     
     return true;
 }
@@ -2,6 +2,7 @@
 #include "pump_transactions.h"
 #include "pump_proto_gkl.h"  /* For PUMP_GKL_LOG_TARGET */
 #include "gkl_link.h"
+#include "fixed_dec.h"
 #include "cdc_logger.h"
 #include <stdio.h>
 #include <string.h>
@@ -15,15 +16,6 @@ static void uint32_to_bcd(uint32_t val, uint8_t *out, uint8_t len)
     }
 }
 
-/* Helper: Convert uint16 to BCD */
-static void uint16_to_bcd(uint16_t val, uint8_t *out, uint8_t len)
-{
-    for (int i = len - 1; i >= 0; i--) {
-        out[i] = (uint8_t)((val % 100) / 10) << 4 | (val % 10);
-        val /= 100;
-    }
-}
-
 /* Helper: Log frame in compact format */
 static void log_frame(uint8_t ctrl, uint8_t slave, char cmd, const uint8_t *data, uint8_t data_len)
 {
@@ -102,18 +94,20 @@ static void log_frame(uint8_t ctrl, uint8_t slave, char cmd, const uint8_t *data
 
 /* V - Preset Volume */
 bool PumpTrans_PresetVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave,
-                            uint8_t nozzle, uint32_t volume_dL, uint16_t price)
+                            uint8_t nozzle, uint32_t volume_dL, uint32_t price, GKL_Completion *done)
 {
+    uint32_t volume_cL;
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
+    if (!FixDec_DLToCL(volume_dL, &volume_cL) || volume_cL > FIXDEC_BCD8_MAX) return false;
+    if (price > FIXDEC_BCD4_MAX) return false;
     
     uint8_t data[7];
     data[0] = nozzle;
     
-    uint32_t volume_cL = volume_dL * 10;
     uint32_to_bcd(volume_cL, &data[1], 4);
-    uint16_to_bcd(price, &data[5], 2);
+    uint32_to_bcd(price, &data[5], 2);
     
-    if (GKL_Send(gkl, ctrl, slave, 'V', data, 7, 'V') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'V', data, 7, 'V', done) == GKL_OK) {
         log_frame(ctrl, slave, 'V', data, 7);
         return true;
     }
@@ -122,16 +116,17 @@ bool PumpTrans_PresetVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave,
 
 /* M - Preset Money */
 bool PumpTrans_PresetMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave,
-                           uint8_t nozzle, uint32_t money, uint16_t price)
+                           uint8_t nozzle, uint32_t money, uint32_t price, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
+    if (money > FIXDEC_BCD8_MAX || price > FIXDEC_BCD4_MAX) return false;
     
     uint8_t data[7];
     data[0] = nozzle;
     uint32_to_bcd(money, &data[1], 4);
-    uint16_to_bcd(price, &data[5], 2);
+    uint32_to_bcd(price, &data[5], 2);
     
-    if (GKL_Send(gkl, ctrl, slave, 'M', data, 7, 'M') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'M', data, 7, 'M', done) == GKL_OK) {
         log_frame(ctrl, slave, 'M', data, 7);
         return true;
     }
@@ -139,11 +134,11 @@ bool PumpTrans_PresetMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave,
 }
 
 /* B - Stop */
-bool PumpTrans_Stop(GKL_Link *gkl, uint8_t ctrl, uint8_t slave)
+bool PumpTrans_Stop(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
     
-    if (GKL_Send(gkl, ctrl, slave, 'B', NULL, 0, 'B') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'B', NULL, 0, 'B', done) == GKL_OK) {
         log_frame(ctrl, slave, 'B', NULL, 0);
         return true;
     }
@@ -151,11 +146,11 @@ bool PumpTrans_Stop(GKL_Link *gkl, uint8_t ctrl, uint8_t slave)
 }
 
 /* G - Resume */
-bool PumpTrans_Resume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave)
+bool PumpTrans_Resume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
     
-    if (GKL_Send(gkl, ctrl, slave, 'G', NULL, 0, 'G') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'G', NULL, 0, 'G', done) == GKL_OK) {
         log_frame(ctrl, slave, 'G', NULL, 0);
         return true;
     }
@@ -163,11 +158,11 @@ bool PumpTrans_Resume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave)
 }
 
 /* N - End Transaction */
-bool PumpTrans_End(GKL_Link *gkl, uint8_t ctrl, uint8_t slave)
+bool PumpTrans_End(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
     
-    if (GKL_Send(gkl, ctrl, slave, 'N', NULL, 0, 'N') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'N', NULL, 0, 'N', done) == GKL_OK) {
         log_frame(ctrl, slave, 'N', NULL, 0);
         return true;
     }
@@ -175,13 +170,13 @@ bool PumpTrans_End(GKL_Link *gkl, uint8_t ctrl, uint8_t slave)
 }
 
 /* L - Poll Realtime Volume */
-bool PumpTrans_PollRealtimeVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle)
+bool PumpTrans_PollRealtimeVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
     
     uint8_t data[1] = {nozzle};
     
-    if (GKL_Send(gkl, ctrl, slave, 'L', data, 1, 'L') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'L', data, 1, 'L', done) == GKL_OK) {
         log_frame(ctrl, slave, 'L', data, 1);
         return true;
     }
@@ -189,13 +184,13 @@ bool PumpTrans_PollRealtimeVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, ui
 }
 
 /* R - Poll Realtime Money */
-bool PumpTrans_PollRealtimeMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle)
+bool PumpTrans_PollRealtimeMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
     
     uint8_t data[1] = {nozzle};
     
-    if (GKL_Send(gkl, ctrl, slave, 'R', data, 1, 'R') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'R', data, 1, 'R', done) == GKL_OK) {
         log_frame(ctrl, slave, 'R', data, 1);
         return true;
     }
@@ -203,13 +198,13 @@ bool PumpTrans_PollRealtimeMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uin
 }
 
 /* C - Read Totalizer */
-bool PumpTrans_ReadTotalizer(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle)
+bool PumpTrans_ReadTotalizer(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
     
     uint8_t data[1] = {nozzle};
     
-    if (GKL_Send(gkl, ctrl, slave, 'C', data, 1, 'C') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'C', data, 1, 'C', done) == GKL_OK) {
         log_frame(ctrl, slave, 'C', data, 1);
         return true;
     }
@@ -217,11 +212,11 @@ bool PumpTrans_ReadTotalizer(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t
 }
 
 /* T - Read Transaction */
-bool PumpTrans_ReadTransaction(GKL_Link *gkl, uint8_t ctrl, uint8_t slave)
+bool PumpTrans_ReadTransaction(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
 {
     if (!gkl || gkl->state != GKL_STATE_IDLE) return false;
     
-    if (GKL_Send(gkl, ctrl, slave, 'T', NULL, 0, 'T') == GKL_OK) {
+    if (GKL_SendEx(gkl, ctrl, slave, 'T', NULL, 0, 'T', done) == GKL_OK) {
         log_frame(ctrl, slave, 'T', NULL, 0);
         return true;
     }
@@ -4,9 +4,10 @@
   * @file    settings.c
   * @brief   Persistent settings stored in external I2C EEPROM with CRC.
   *
-  * EEPROM layout (256B minimal):
-  *  - Slot A at 0x00..0x7F
-  *  - Slot B at 0x80..0xFF
+  * EEPROM layout (512B minimal):
+  *  - Slot A at 0x000..0x0FF
+  *  - Slot B at 0x100..0x1FF
+  *  - 0x200.. transaction journal (trx_journal.c), shares the I2C handle
   *
   * Record header:
   *  [0]  u32 magic   = 'SET1'
@@ -17,13 +18,20 @@
   *  [16] payload bytes...
   *  rest filled with 0xFF
   *
-  * Payload format (compact):
+  * Payload format v2 (compact):
   *  [0] pump_count
+  *  [1] link_count
   *  for each pump i:
+  *    link (1)
   *    ctrl_addr (1)
   *    slave_addr (1)
+  *    nozzle_count (1)
   *    price_le16 (2)
   *
+  * v1 (128-byte slots at 0x00/0x80, payload: pump_count, then ctrl, slave,
+  * price_le16 per pump with pump i on link i) is still loaded; the next save
+  * writes v2 to slot B, clear of both v1 copies.
+  *
   * Async save: writes pages with HAL_I2C_Mem_Write_IT and waits EEPROM internal
   * write cycle using lightweight HAL_I2C_IsDeviceReady(..., trials=1, timeout=1).
   ******************************************************************************
@@ -31,6 +39,7 @@
 /* USER CODE END Header */
 
 #include "settings.h"
+#include "trx_journal.h"
 #include <string.h>
 
 /* Singleton pointer for HAL I2C callbacks dispatching */
@@ -92,14 +101,14 @@ static bool eeprom_read_block(I2C_HandleTypeDef *hi2c, uint16_t mem_addr, uint8_
 {
     if (hi2c == NULL || dst == NULL || len == 0u) return false;
 
-    /* Timeout: small but enough for 128 bytes at 100 kHz */
+    /* Timeout: small but enough for 256 bytes at 100 kHz */
     if (HAL_I2C_Mem_Read(hi2c,
                          SETTINGS_EEPROM_I2C_ADDR,
                          mem_addr,
                          SETTINGS_EEPROM_MEMADD_SIZE,
                          dst,
                          len,
-                         50u) == HAL_OK)
+                         100u) == HAL_OK)
     {
         return true;
     }
@@ -107,7 +116,7 @@ static bool eeprom_read_block(I2C_HandleTypeDef *hi2c, uint16_t mem_addr, uint8_
 }
 
 /* ---------------- Record parse/build ---------------- */
-static bool parse_slot(const uint8_t *slot, SettingsData *out, uint32_t *out_seq)
+static bool parse_slot(const uint8_t *slot, uint16_t slot_size, SettingsData *out, uint32_t *out_seq)
 {
     if (slot == NULL || out == NULL || out_seq == NULL) return false;
 
@@ -118,9 +127,9 @@ static bool parse_slot(const uint8_t *slot, SettingsData *out, uint32_t *out_seq
     uint32_t crc_s = rd_u32_le(&slot[12]);
 
     if (magic != SETTINGS_MAGIC) return false;
-    if (ver != (uint16_t)SETTINGS_VERSION) return false;
+    if (ver != (uint16_t)SETTINGS_VERSION && ver != (uint16_t)SETTINGS_VERSION_V1) return false;
     if (plen == 0u) return false;
-    if ((uint32_t)(16u + plen) > (uint32_t)SETTINGS_SLOT_SIZE) return false;
+    if ((uint32_t)(16u + plen) > (uint32_t)slot_size) return false;
 
     const uint8_t *payload = &slot[16];
     uint32_t crc_c = crc32_calc(payload, (uint32_t)plen);
@@ -133,17 +142,42 @@ static bool parse_slot(const uint8_t *slot, SettingsData *out, uint32_t *out_seq
     if (pump_count == 0u) return false;
     if (pump_count > (uint8_t)SETTINGS_MAX_PUMPS) pump_count = (uint8_t)SETTINGS_MAX_PUMPS;
 
-    uint32_t needed = 1u + (uint32_t)pump_count * 4u;
-    if ((uint32_t)plen < needed) return false;
-
     out->pump_count = pump_count;
-    uint32_t off = 1u;
-    for (uint8_t i = 0; i < pump_count; i++)
+
+    if (ver == (uint16_t)SETTINGS_VERSION_V1)
+    {
+        /* v1: one pump per link, single nozzle */
+        uint32_t needed = 1u + (uint32_t)pump_count * 4u;
+        if ((uint32_t)plen < needed) return false;
+
+        out->link_count = pump_count;
+        uint32_t off = 1u;
+        for (uint8_t i = 0; i < pump_count; i++)
+        {
+            out->pump[i].link         = i;
+            out->pump[i].ctrl_addr    = payload[off + 0u];
+            out->pump[i].slave_addr   = payload[off + 1u];
+            out->pump[i].nozzle_count = 1u;
+            out->pump[i].price        = rd_u16_le(&payload[off + 2u]);
+            off += 4u;
+        }
+    }
+    else
     {
-        out->pump[i].ctrl_addr  = payload[off + 0u];
-        out->pump[i].slave_addr = payload[off + 1u];
-        out->pump[i].price      = rd_u16_le(&payload[off + 2u]);
-        off += 4u;
+        uint32_t needed = SETTINGS_PAYLOAD_HDR + (uint32_t)pump_count * SETTINGS_PUMP_REC_SIZE;
+        if ((uint32_t)plen < needed) return false;
+
+        out->link_count = payload[1];
+        uint32_t off = SETTINGS_PAYLOAD_HDR;
+        for (uint8_t i = 0; i < pump_count; i++)
+        {
+            out->pump[i].link         = payload[off + 0u];
+            out->pump[i].ctrl_addr    = payload[off + 1u];
+            out->pump[i].slave_addr   = payload[off + 2u];
+            out->pump[i].nozzle_count = payload[off + 3u];
+            out->pump[i].price        = rd_u16_le(&payload[off + 4u]);
+            off += SETTINGS_PUMP_REC_SIZE;
+        }
     }
 
     *out_seq = seq;
@@ -163,14 +197,17 @@ static void build_slot_image(const Settings *s, uint32_t seq, uint8_t *slot_out)
     if (count > (uint8_t)SETTINGS_MAX_PUMPS) count = (uint8_t)SETTINGS_MAX_PUMPS;
 
     payload[0] = count;
-    uint32_t poff = 1u;
+    payload[1] = s->data.link_count;
+    uint32_t poff = SETTINGS_PAYLOAD_HDR;
 
     for (uint8_t i = 0; i < count; i++)
     {
-        payload[poff + 0u] = s->data.pump[i].ctrl_addr;
-        payload[poff + 1u] = s->data.pump[i].slave_addr;
-        wr_u16_le(&payload[poff + 2u], s->data.pump[i].price);
-        poff += 4u;
+        payload[poff + 0u] = s->data.pump[i].link;
+        payload[poff + 1u] = s->data.pump[i].ctrl_addr;
+        payload[poff + 2u] = s->data.pump[i].slave_addr;
+        payload[poff + 3u] = s->data.pump[i].nozzle_count;
+        wr_u16_le(&payload[poff + 4u], s->data.pump[i].price);
+        poff += SETTINGS_PUMP_REC_SIZE;
     }
 
     uint16_t payload_len = (uint16_t)poff;
@@ -192,9 +229,14 @@ static void clamp_data(SettingsData *d)
 
     if (d->pump_count == 0u) d->pump_count = 1u;
     if (d->pump_count > (uint8_t)SETTINGS_MAX_PUMPS) d->pump_count = (uint8_t)SETTINGS_MAX_PUMPS;
+    if (d->link_count == 0u) d->link_count = 1u;
+    if (d->link_count > (uint8_t)SETTINGS_MAX_LINKS) d->link_count = (uint8_t)SETTINGS_MAX_LINKS;
 
     for (uint8_t i = 0; i < d->pump_count; i++)
     {
+        if (d->pump[i].link >= d->link_count) d->pump[i].link = (uint8_t)(d->link_count - 1u);
+        if (d->pump[i].nozzle_count == 0u) d->pump[i].nozzle_count = 1u;
+        if (d->pump[i].nozzle_count > (uint8_t)PUMP_MGR_MAX_NOZZLES) d->pump[i].nozzle_count = (uint8_t)PUMP_MGR_MAX_NOZZLES;
         if (d->pump[i].slave_addr == 0u) d->pump[i].slave_addr = 1u;
         if (d->pump[i].slave_addr > 32u) d->pump[i].slave_addr = 32u;
         if (d->pump[i].price > 9999u) d->pump[i].price = 9999u;
@@ -209,16 +251,21 @@ void Settings_Defaults(Settings *s)
 
     memset(&s->data, 0, sizeof(s->data));
     s->data.pump_count = 2u;
+    s->data.link_count = 2u;
 
     /* TRK1 default */
-    s->data.pump[0].ctrl_addr  = 0x00u;
-    s->data.pump[0].slave_addr = 0x01u;
-    s->data.pump[0].price      = 0u;
-
-    /* TRK2 default (different address for debug) */
-    s->data.pump[1].ctrl_addr  = 0x00u;
-    s->data.pump[1].slave_addr = 0x02u;
-    s->data.pump[1].price      = 0u;
+    s->data.pump[0].link         = 0u;
+    s->data.pump[0].ctrl_addr    = 0x00u;
+    s->data.pump[0].slave_addr   = 0x01u;
+    s->data.pump[0].nozzle_count = 1u;
+    s->data.pump[0].price        = 0u;
+
+    /* TRK2 default (own link, different address for debug) */
+    s->data.pump[1].link         = 1u;
+    s->data.pump[1].ctrl_addr    = 0x00u;
+    s->data.pump[1].slave_addr   = 0x02u;
+    s->data.pump[1].nozzle_count = 1u;
+    s->data.pump[1].price        = 0u;
 
     s->seq = 0u;
     s->last_slot = 0u;
@@ -254,32 +301,35 @@ bool Settings_Load(Settings *s)
     bool r0 = eeprom_read_block(s->hi2c, (uint16_t)SETTINGS_SLOT0_ADDR, slot0, SETTINGS_SLOT_SIZE);
     bool r1 = eeprom_read_block(s->hi2c, (uint16_t)SETTINGS_SLOT1_ADDR, slot1, SETTINGS_SLOT_SIZE);
 
-    SettingsData d0, d1;
-    uint32_t seq0 = 0u, seq1 = 0u;
-
-    bool v0 = false;
-    bool v1 = false;
+    /* Candidates: v2 slot A/B, plus a v1 slot B inside the v2 slot A area.
+       Both v1 copies lie in slot A, so a v1 record counts as slot A: the
+       first v2 save then goes to slot B and never overwrites the only
+       valid copy. */
+    const uint8_t *cand[3] = { r0 ? slot0 : NULL, r1 ? slot1 : NULL,
+                               r0 ? &slot0[SETTINGS_V1_SLOT1_ADDR] : NULL };
+    const uint16_t cand_size[3] = { SETTINGS_SLOT_SIZE, SETTINGS_SLOT_SIZE, SETTINGS_V1_SLOT_SIZE };
+    const uint8_t cand_slot[3] = { 0u, 1u, 0u };
 
-    if (r0) v0 = parse_slot(slot0, &d0, &seq0);
-    if (r1) v1 = parse_slot(slot1, &d1, &seq1);
+    SettingsData d;
+    uint32_t seq = 0u;
+    bool found = false;
 
-    if (!v0 && !v1)
+    for (uint8_t i = 0u; i < 3u; i++)
     {
-        Settings_Defaults(s);
-        return false;
+        if (cand[i] == NULL) continue;
+        if (!parse_slot(cand[i], cand_size[i], &d, &seq)) continue;
+        if (found && seq < s->seq) continue;
+
+        s->data = d;
+        s->seq = seq;
+        s->last_slot = cand_slot[i];
+        found = true;
     }
 
-    if (v0 && (!v1 || (seq0 >= seq1)))
+    if (!found)
     {
-        s->data = d0;
-        s->seq = seq0;
-        s->last_slot = 0u;
-    }
-    else
-    {
-        s->data = d1;
-        s->seq = seq1;
-        s->last_slot = 1u;
+        Settings_Defaults(s);
+        return false;
     }
 
     clamp_data(&s->data);
@@ -319,7 +369,8 @@ bool Settings_RequestSave(Settings *s)
 
     s->wr_active = 1u;
     s->wr_inflight = 0u;
-    s->wr_wait_ready = 0u;
+    /* The EEPROM may still be in the write cycle of a journal record */
+    s->wr_wait_ready = 1u;
 
     s->wr_base = base;
     s->wr_off = 0u;
@@ -410,12 +461,18 @@ void Settings_Task(Settings *s)
 
     s->wr_chunk = chunk;
 
-    if (HAL_I2C_Mem_Write_IT(s->hi2c,
-                            SETTINGS_EEPROM_I2C_ADDR,
-                            abs_addr,
-                            SETTINGS_EEPROM_MEMADD_SIZE,
-                            (uint8_t*)&s->wr_buf[s->wr_off],
-                            chunk) != HAL_OK)
+    HAL_StatusTypeDef st = HAL_I2C_Mem_Write_IT(s->hi2c,
+                                                SETTINGS_EEPROM_I2C_ADDR,
+                                                abs_addr,
+                                                SETTINGS_EEPROM_MEMADD_SIZE,
+                                                (uint8_t*)&s->wr_buf[s->wr_off],
+                                                chunk);
+    if (st == HAL_BUSY)
+    {
+        /* Bus shared with the transaction journal: try again next pass */
+        return;
+    }
+    if (st != HAL_OK)
     {
         s->wr_active = 0u;
         s->save_state = SETTINGS_SAVE_ERROR;
@@ -440,6 +497,7 @@ void Settings_ApplyToPumpMgr(const Settings *s, PumpMgr *m)
         uint8_t id = (uint8_t)(i + 1u);
         (void)PumpMgr_SetCtrlAddr(m, id, s->data.pump[i].ctrl_addr);
         (void)PumpMgr_SetSlaveAddr(m, id, s->data.pump[i].slave_addr);
+        (void)PumpMgr_SetNozzleCount(m, id, s->data.pump[i].nozzle_count);
         (void)PumpMgr_SetPrice(m, id, (uint32_t)s->data.pump[i].price);
     }
 }
@@ -448,17 +506,17 @@ void Settings_CaptureFromPumpMgr(Settings *s, const PumpMgr *m)
 {
     if (s == NULL || m == NULL) return;
 
-    uint8_t count = m->count;
-    if (count == 0u) count = 1u;
-    if (count > (uint8_t)SETTINGS_MAX_PUMPS) count = (uint8_t)SETTINGS_MAX_PUMPS;
-
-    s->data.pump_count = count;
+    /* Topology (pump count, links) is owned by the settings; only runtime
+       values of pumps the manager knows are captured */
+    uint8_t count = s->data.pump_count;
 
     for (uint8_t i = 0u; i < count; i++)
     {
         uint8_t id = (uint8_t)(i + 1u);
+        if (PumpMgr_GetConst(m, id) == NULL) continue;
         s->data.pump[i].ctrl_addr  = PumpMgr_GetCtrlAddr(m, id);
         s->data.pump[i].slave_addr = PumpMgr_GetSlaveAddr(m, id);
+        s->data.pump[i].nozzle_count = PumpMgr_GetNozzleCount(m, id);
         uint32_t pr = PumpMgr_GetPrice(m, id);
         if (pr > 9999u) pr = 9999u;
         s->data.pump[i].price = (uint16_t)pr;
@@ -516,6 +574,8 @@ void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
         s->wr_wait_ready = 1u;
         s->wr_ready_start_ms = 0u;
     }
+
+    TrxJournal_OnI2CTxCplt(hi2c);
 }
 
 void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
@@ -524,7 +584,8 @@ void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
     if (s == NULL || hi2c == NULL) return;
     if (hi2c != s->hi2c) return;
 
-    if (s->wr_active)
+    /* Only our own transfer: the journal shares this I2C */
+    if (s->wr_active && s->wr_inflight)
     {
         s->wr_active = 0u;
         s->wr_inflight = 0u;
@@ -532,4 +593,6 @@ void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
         s->save_state = SETTINGS_SAVE_ERROR;
         s->save_error = 3u; /* HAL I2C error */
     }
+
+    TrxJournal_OnI2CError(hi2c);
 }
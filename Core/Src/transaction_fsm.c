@@ -1,215 +1,835 @@
-/* transaction_fsm.c - Transaction State Machine Implementation */
+/* transaction_fsm.c - Transaction State Machine Implementation (transition table) */
 #include "transaction_fsm.h"
 #include "pump_transactions.h"
 #include "pump_response_parser.h"
 #include "gkl_link.h"
+#include "fixed_dec.h"
+#include "cdc_logger.h"
 #include "stm32h7xx_hal.h"
+#include <stdio.h>
 #include <string.h>
 
-void TrxFSM_Init(TransactionFSM *fsm, uint8_t pump_id, PumpMgr *mgr, PumpProtoGKL *gkl)
+/* Table wildcards */
+#define TRX_ANY     (0xFEu)     /* entry matches in every state */
+#define TRX_SAME    (0xFFu)     /* stay in the current state */
+
+typedef bool (*TrxGuard)(TransactionFSM *fsm, const TrxEvent *ev);
+typedef bool (*TrxAction)(TransactionFSM *fsm, const TrxEvent *ev);
+
+typedef struct {
+    uint8_t   state;    /* TrxState or TRX_ANY */
+    uint8_t   event;    /* TrxEventType */
+    TrxGuard  guard;    /* NULL = always */
+    TrxAction action;   /* NULL = none; false = link busy, nothing sent */
+    uint8_t   next;     /* TrxState or TRX_SAME */
+} TrxTransition;
+
+/* ===== Helpers ===== */
+
+/* Pump addresses and the link, if the link can take a command now
+   (and the reply slot has been read, a new request would clear it) */
+static GKL_Link *trxfsm_link(TransactionFSM *fsm, PumpSnapshot *dev)
 {
-    if (!fsm) return;
+    if (fsm->done.done) return NULL;
+    if (!fsm->gkl || !PumpMgr_Snapshot(fsm->mgr, fsm->pump_id, dev)) return NULL;
+    GKL_Link *gkl = &fsm->gkl->link;
+    return (gkl->state == GKL_STATE_IDLE) ? gkl : NULL;
+}
+
+static void trxfsm_arm(TransactionFSM *fsm, uint32_t delay_ms)
+{
+    fsm->timer_armed = (delay_ms != 0u);
+    fsm->timer_deadline_ms = HAL_GetTick() + delay_ms;
+}
+
+static void trxfsm_record(TransactionFSM *fsm, TrxRecordType type, TrxState from, TrxState to)
+{
+    if (!fsm->record_fn) return;
+
+    TrxRecord r;
+    memset(&r, 0, sizeof(r));
+    r.type = (uint8_t)type;
+    r.pump_id = fsm->pump_id;
+    r.from = (uint8_t)from;
+    r.to = (uint8_t)to;
+    r.pump_status = fsm->pump_status;
+    r.preset_money = fsm->preset_is_money;
+    r.price = fsm->sale_price;
+    r.preset = fsm->preset_is_money ? fsm->preset_money : fsm->preset_volume_dL;
+    r.volume_dL = fsm->rt_volume_dL;
+    r.money = fsm->rt_money;
+    r.recon = fsm->recon;
+    r.tot_after_valid = fsm->tot_after_valid;
+    r.tot_after_cL = fsm->tot_after_cL;
+    fsm->record_fn(fsm->record_ctx, &r);
+}
+
+/* ===== Guards ===== */
+
+static bool g_armed(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)fsm;
+    return ev->status == 3;
+}
+
+static bool g_flowing(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)fsm;
+    return ev->status == 4 || ev->status == 6;
+}
+
+static bool g_sale_end(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)fsm;
+    return ev->status == 8;
+}
+
+static bool g_nozzle_back(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)fsm;
+    return ev->status == 9;
+}
+
+static bool g_closed(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)fsm;
+    return ev->status == 1;
+}
+
+/* Timer guard: pump still holds an authorisation (S3) or waits for 'N' (S9) */
+static bool g_still_open(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    return fsm->pump_status == 3 || fsm->pump_status == 9;
+}
+
+/* A preset is waiting for the current sale to close */
+static bool g_queued(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    return fsm->next_valid;
+}
+
+/* Timer guard after a withdrawn preset: the pump answered S1 to a poll
+   made after the 'N' (no status change is notified if it never left S1) */
+static bool g_pump_idle(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    PumpSnapshot dev;
+    return PumpMgr_Snapshot(fsm->mgr, fsm->pump_id, &dev) && dev.status == 1 &&
+           (int32_t)(dev.last_status_ms - fsm->withdraw_ms) > 0;
+}
+
+/* No presets while a station price update is switching over */
+static bool g_can_authorise(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    return PumpMgr_CanAuthorise(fsm->mgr, fsm->pump_id);
+}
+
+/* ===== Actions ===== */
+
+static bool a_clear(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    fsm->sale_open = false;
+    fsm->preset_volume_dL = 0u;
+    fsm->preset_money = 0u;
+    fsm->preset_is_money = false;
+    fsm->target_dL = 0u;
+    fsm->sale_price = 0u;
+    fsm->rt_volume_dL = 0;
+    fsm->rt_money = 0;
+    fsm->disp_mdL = 0u;
+    fsm->money_agree = 0u;
+    fsm->money_mismatch = false;
+    fsm->trx_valid = false;
+    fsm->t_tries = 0u;
+    fsm->c_tries = 0u;
+    fsm->tot_after_valid = false;
+    fsm->recon = 0u;
+    return true;
+}
+
+/* Preset for the next customer; a second one replaces the first */
+static bool a_queue_preset(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    char msg[48];
+    snprintf(msg, sizeof(msg), "TRK%u: next %s %lu%s", (unsigned)fsm->pump_id,
+             (ev->type == TRX_EV_START_MONEY) ? "money" : "volume",
+             (unsigned long)ev->value, fsm->next_valid ? " (replaced)" : "");
+    CDC_Log(msg);
+
+    fsm->next_valid = true;
+    fsm->next_type = (uint8_t)ev->type;
+    fsm->next_value = ev->value;
+    return true;
+}
+
+static bool a_unqueue(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    fsm->next_valid = false;
+    return true;
+}
+
+/* Final figures: the pump's 'T' record is authoritative over the last
+   (lagging) realtime sample; the totalizer delta cross-checks the volume */
+static void trxfsm_reconcile(TransactionFSM *fsm)
+{
+    uint8_t recon = 0u;
+
+    if (fsm->trx_valid) {
+        if (fsm->rt_volume_dL > fsm->trx_volume_dL + 1u) recon |= TRX_RECON_RT_DIFF;
+        fsm->rt_volume_dL = fsm->trx_volume_dL;
+        fsm->rt_money = fsm->trx_money;
+        if (fsm->trx_price != 0u) fsm->sale_price = fsm->trx_price;
+        recon |= TRX_RECON_FROM_T;
+    }
+
+    if (fsm->tot_before_valid && fsm->tot_after_valid && fsm->tot_after_cL >= fsm->tot_before_cL) {
+        uint32_t delta_dL = FixDec_CLToDL(fsm->tot_after_cL - fsm->tot_before_cL, FIXDEC_VOLUME_ROUND);
+        uint32_t diff = (delta_dL > fsm->rt_volume_dL) ? delta_dL - fsm->rt_volume_dL : fsm->rt_volume_dL - delta_dL;
+        recon |= (diff <= 1u) ? TRX_RECON_TOT_OK : TRX_RECON_TOT_DIFF;
+    }
+
+    if (recon & (TRX_RECON_RT_DIFF | TRX_RECON_TOT_DIFF)) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "TRK%u: sale %lu dL, recon 0x%02X",
+                 (unsigned)fsm->pump_id, (unsigned long)fsm->rt_volume_dL, (unsigned)recon);
+        CDC_Log(msg);
+    }
+    fsm->recon = recon;
+}
+
+/* Pump back to idle after 'N': the sale is final. A stale S9 closed
+   without a preset of ours (e.g. after a reboot) is no sale: only the
+   CLOSING -> IDLE transition is recorded. */
+/* Totalizer after the sale from the manager's cache: any reading taken
+   at or after S8 will do, whether or not it changed (zero-volume sale) */
+static void trxfsm_tot_after_cached(TransactionFSM *fsm)
+{
+    PumpTotalizer t;
+    if (fsm->tot_after_valid) return;
+    if (!PumpMgr_GetTotalizer(fsm->mgr, fsm->pump_id, 1u, &t) || !t.valid) return;
+    if ((int32_t)(t.stamp_ms - fsm->end_ms) < 0) return;
+    fsm->tot_after_valid = true;
+    fsm->tot_after_cL = t.value;
+}
+
+static bool a_finish(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    if (fsm->sale_open) {
+        trxfsm_tot_after_cached(fsm);
+        trxfsm_reconcile(fsm);
+        TrxMetrics_Stamp(&fsm->metrics, TRX_PH_CLOSED, HAL_GetTick());
+        TrxMetrics_Close(&fsm->metrics, fsm->rt_volume_dL);
+        trxfsm_record(fsm, TRX_REC_SALE, TRX_CLOSING, TRX_IDLE);
+    } else {
+        TrxMetrics_Reset(&fsm->metrics);
+    }
+    return a_clear(fsm, ev);
+}
+
+/* Withdrawn preset, pump confirmed S1 by a later poll */
+static bool a_finish_idle(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    fsm->pump_status = 1;
+    return a_finish(fsm, ev);
+}
+
+/* Totalizer before the sale, for the delta check at the end */
+static void trxfsm_tot_before(TransactionFSM *fsm)
+{
+    PumpTotalizer tot;
+    fsm->tot_before_valid = PumpMgr_GetTotalizer(fsm->mgr, fsm->pump_id, 1u, &tot) && tot.valid;
+    fsm->tot_before_cL = fsm->tot_before_valid ? tot.value : 0u;
+}
+
+static bool a_preset_volume(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    PumpSnapshot dev;
+    GKL_Link *gkl = trxfsm_link(fsm, &dev);
+    if (!gkl || !PumpTrans_PresetVolume(gkl, dev.ctrl_addr, dev.slave_addr, 1, ev->value, dev.price, &fsm->done)) {
+        return false;
+    }
+    (void)a_clear(fsm, ev);
+    fsm->sale_open = true;
+    fsm->preset_volume_dL = ev->value;
+    fsm->preset_is_money = false;
+    fsm->target_dL = ev->value;
+    fsm->sale_price = dev.price;
+    trxfsm_tot_before(fsm);
+    return true;
+}
+
+static bool a_preset_money(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    PumpSnapshot dev;
+    GKL_Link *gkl = trxfsm_link(fsm, &dev);
+    if (!gkl || !PumpTrans_PresetMoney(gkl, dev.ctrl_addr, dev.slave_addr, 1, ev->value, dev.price, &fsm->done)) {
+        return false;
+    }
+    (void)a_clear(fsm, ev);
+    fsm->sale_open = true;
+    fsm->preset_money = ev->value;
+    fsm->preset_is_money = true;
+    if (!FixDec_DLOfMoney(ev->value, dev.price, FIXDEC_ROUND_DOWN, &fsm->target_dL)) fsm->target_dL = 0u;
+    fsm->sale_price = dev.price;
+    trxfsm_tot_before(fsm);
+    return true;
+}
+
+static bool a_send_end(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    PumpSnapshot dev;
+    GKL_Link *gkl = trxfsm_link(fsm, &dev);
+    return gkl && PumpTrans_End(gkl, dev.ctrl_addr, dev.slave_addr, &fsm->done);
+}
+
+/* Preset taken back before any fuel flowed: 'N' cancels the authorisation
+   at the pump (a late lift would otherwise dispense an untracked sale);
+   nothing was sold, so no SALE record when the pump is back at S1. The
+   S1 seen before the 'N' proves nothing: wait for a fresh one. */
+static bool a_withdraw(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    if (!a_send_end(fsm, ev)) return false;
+    fsm->sale_open = false;
+    fsm->withdraw_ms = HAL_GetTick();
+    if (fsm->pump_status == 1) fsm->pump_status = 0;
+    PumpMgr_RequestPollNow(fsm->mgr, fsm->pump_id);
+    return true;
+}
+
+static bool a_drop_preset(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    if (!a_withdraw(fsm, ev)) return false;
+
+    char msg[48];
+    snprintf(msg, sizeof(msg), "TRK%u: %s, withdrawn", (unsigned)fsm->pump_id,
+             (fsm->state == TRX_ARMED) ? "nozzle not lifted" : "preset not armed");
+    CDC_Log(msg);
+    return true;
+}
+
+/* Pump went back to S1 from S3 on its own (authorisation ended at the
+   pump): no fuel flowed, so no sale and no 'N' */
+static bool a_auth_dropped(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    char msg[48];
+    snprintf(msg, sizeof(msg), "TRK%u: authorisation dropped by the pump", (unsigned)fsm->pump_id);
+    CDC_Log(msg);
+
+    fsm->sale_open = false;
+    return a_finish(fsm, ev);
+}
+
+/* Link above its utilisation target: extra requests give way to other pumps */
+static bool trxfsm_bus_loaded(const TransactionFSM *fsm)
+{
+    const PumpDevice *d = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
+    PumpMgrBusStats st;
+    return d && PumpMgr_GetBusStats(fsm->mgr, d->link, &st) && st.stretch > 1u;
+}
+
+static bool a_poll_rt(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    PumpSnapshot dev;
+    GKL_Link *gkl = trxfsm_link(fsm, &dev);
+    if (!gkl) return false;
+
+    /* Next plan step that needs a frame; R and S steps may be skipped */
+    const char *plan = fsm->poll_plan;
+    uint8_t len = (uint8_t)strlen(plan);
+    bool loaded = trxfsm_bus_loaded(fsm);
+    char step = 'L';
+    for (uint8_t n = 0; n < len; n++) {
+        char c = plan[fsm->plan_pos];
+        fsm->plan_pos = (uint8_t)((fsm->plan_pos + 1u) % len);
+        if (c == 'S') {
+            if (!loaded) PumpMgr_RequestPollNow(fsm->mgr, fsm->pump_id);
+            continue;
+        }
+        if (c == 'R' && (loaded || fsm->money_agree >= TRX_FSM_MONEY_AGREE)) continue;
+        step = c;
+        break;
+    }
+
+    bool sent = (step == 'R')
+              ? PumpTrans_PollRealtimeMoney(gkl, dev.ctrl_addr, dev.slave_addr, 1, &fsm->done)
+              : PumpTrans_PollRealtimeVolume(gkl, dev.ctrl_addr, dev.slave_addr, 1, &fsm->done);
+    if (!sent) return false;
+
+    /* Bank what this poll saved against the average rate (may spend it) */
+    uint32_t now = HAL_GetTick();
+    uint32_t bank = fsm->rt_bank_ms + (now - fsm->last_rt_poll_ms);
+    bank = (bank > TRX_FSM_RT_POLL_MS) ? bank - TRX_FSM_RT_POLL_MS : 0u;
+    fsm->rt_bank_ms = (bank > TRX_FSM_RT_BANK_MS) ? TRX_FSM_RT_BANK_MS : bank;
+    fsm->last_rt_poll_ms = now;
+    return true;
+}
+
+static bool a_stop(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    PumpSnapshot dev;
+    GKL_Link *gkl = trxfsm_link(fsm, &dev);
+    return gkl && PumpTrans_Stop(gkl, dev.ctrl_addr, dev.slave_addr, &fsm->done);
+}
+
+static bool a_resume(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    PumpSnapshot dev;
+    GKL_Link *gkl = trxfsm_link(fsm, &dev);
+    return gkl && PumpTrans_Resume(gkl, dev.ctrl_addr, dev.slave_addr, &fsm->done);
+}
+
+/* Next read after S8: 'T', then the totalizer; 0 = done or given up */
+static char trxfsm_final_step(const TransactionFSM *fsm)
+{
+    if (!fsm->trx_valid && fsm->t_tries < TRX_FSM_FINAL_TRIES) return 'T';
+    if (!fsm->tot_after_valid && fsm->c_tries < TRX_FSM_FINAL_TRIES) return 'C';
+    return 0;
+}
+
+static bool a_read_final(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    (void)ev;
+    trxfsm_tot_after_cached(fsm);
+    char step = trxfsm_final_step(fsm);
+    if (!step) return true;
+
+    PumpSnapshot dev;
+    GKL_Link *gkl = trxfsm_link(fsm, &dev);
+    if (!gkl) return false;
+
+    if (step == 'T') {
+        if (!PumpTrans_ReadTransaction(gkl, dev.ctrl_addr, dev.slave_addr, &fsm->done)) return false;
+        fsm->t_tries++;
+    } else {
+        /* On our own slot; the reply is handed to the manager's cache */
+        if (!PumpTrans_ReadTotalizer(gkl, dev.ctrl_addr, dev.slave_addr, 1u, &fsm->done)) return false;
+        fsm->c_tries++;
+    }
+    return true;
+}
+
+/* Next 'L' poll: half the predicted time to preset, within the bounds,
+   and below the average rate only as far as the bank allows */
+static uint32_t trxfsm_rt_interval(const TransactionFSM *fsm)
+{
+    uint32_t ms = TRX_FSM_RT_POLL_MS;
+
+    if (fsm->flow_mdL_s != 0u && fsm->target_dL != 0u) {
+        uint32_t left_dL = (fsm->target_dL > fsm->rt_volume_dL) ? fsm->target_dL - fsm->rt_volume_dL : 0u;
+        uint64_t eta_ms = ((uint64_t)left_dL * 1000000u) / fsm->flow_mdL_s;
+        uint64_t half = eta_ms / 2u;
+        ms = (half > TRX_FSM_RT_POLL_MAX_MS) ? TRX_FSM_RT_POLL_MAX_MS : (uint32_t)half;
+        if (ms < TRX_FSM_RT_POLL_MIN_MS) ms = TRX_FSM_RT_POLL_MIN_MS;
+    }
+
+    if (ms < TRX_FSM_RT_POLL_MS && (TRX_FSM_RT_POLL_MS - ms) > fsm->rt_bank_ms) {
+        ms = TRX_FSM_RT_POLL_MS - fsm->rt_bank_ms;
+    }
+    return ms;
+}
+
+/* Flow rate from successive 'L' samples */
+static void trxfsm_flow_sample(TransactionFSM *fsm, uint32_t volume_dL)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t dt = now - fsm->last_sample_ms;
+
+    if (fsm->have_sample && dt > 0u && volume_dL >= fsm->last_sample_dL) {
+        uint32_t rate = (uint32_t)(((uint64_t)(volume_dL - fsm->last_sample_dL) * 1000000u) / dt);
+        if (fsm->flow_mdL_s == 0u) {
+            fsm->flow_mdL_s = rate;
+        } else {
+            int32_t diff = (int32_t)(rate - fsm->flow_mdL_s);
+            fsm->flow_mdL_s = (uint32_t)((int32_t)fsm->flow_mdL_s + diff / (1 << TRX_FSM_FLOW_SHIFT));
+        }
+    }
+    fsm->have_sample = true;
+    fsm->last_sample_ms = now;
+    fsm->last_sample_dL = volume_dL;
+}
+
+/* Money for a volume at the sale price (price is per litre) */
+static uint32_t trxfsm_money_of(const TransactionFSM *fsm, uint64_t volume_mdL)
+{
+    uint32_t money;
+    if (volume_mdL > UINT32_MAX ||
+        !FixDec_MoneyOfMDL((uint32_t)volume_mdL, fsm->sale_price, FIXDEC_MONEY_ROUND, &money)) {
+        return UINT32_MAX;
+    }
+    return money;
+}
+
+/* Last 'L' sample moved on by the flow rate for dt_ms */
+static uint64_t trxfsm_project_mdL(const TransactionFSM *fsm, uint32_t dt_ms)
+{
+    return (uint64_t)fsm->rt_volume_dL * FIXDEC_MDL_PER_DL + ((uint64_t)fsm->flow_mdL_s * dt_ms) / 1000u;
+}
+
+/* Compare an R reply with volume x price, projected to now by the flow rate */
+static void trxfsm_check_money(TransactionFSM *fsm, uint32_t money)
+{
+    if (fsm->sale_price == 0u || !fsm->have_sample) return;
+
+    uint32_t local = trxfsm_money_of(fsm, trxfsm_project_mdL(fsm, HAL_GetTick() - fsm->last_sample_ms));
+    uint32_t diff = (money > local) ? money - local : local - money;
+
+    /* Volume resolution is 1 dL: allow one dL worth of money either way */
+    if (diff <= fsm->sale_price / 10u + 1u) {
+        if (fsm->money_agree < TRX_FSM_MONEY_AGREE) fsm->money_agree++;
+        fsm->money_mismatch = false;
+    } else {
+        fsm->money_agree = 0u;
+        fsm->money_mismatch = true;
+    }
+}
+
+static bool a_store_reply(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    if (ev->cmd == 'L') {
+        fsm->rt_volume_dL = ev->value;
+        if (!fsm->money_mismatch && fsm->sale_price != 0u) {
+            fsm->rt_money = trxfsm_money_of(fsm, (uint64_t)ev->value * 1000u);
+        }
+        if (fsm->state == TRX_DISPENSING) {
+            trxfsm_flow_sample(fsm, ev->value);
+
+            /* A closer end than predicted at the last poll pulls the timer in */
+            uint32_t due = fsm->last_rt_poll_ms + trxfsm_rt_interval(fsm);
+            if (fsm->timer_armed && (int32_t)(due - fsm->timer_deadline_ms) < 0) {
+                fsm->timer_deadline_ms = due;
+            }
+        }
+    } else if (ev->cmd == 'R') {
+        if (fsm->state == TRX_DISPENSING) trxfsm_check_money(fsm, ev->value);
+        fsm->rt_money = ev->value;
+    } else if (ev->cmd == 'T') {
+        fsm->trx_valid = true;
+        fsm->trx_volume_dL = ev->value;
+        fsm->trx_money = ev->money;
+        fsm->trx_price = ev->price;
+        /* Totalizer read follows without waiting for the retry interval */
+        if (fsm->state == TRX_COMPLETE && trxfsm_final_step(fsm)) trxfsm_arm(fsm, TRX_FSM_RETRY_MS);
+    } else if (ev->cmd == 'C') {
+        /* Our own read: counts even if the value did not change */
+        if (ev->nozzle == 1u && (fsm->state == TRX_COMPLETE || fsm->state == TRX_CLOSING)) {
+            fsm->tot_after_valid = true;
+            fsm->tot_after_cL = ev->value;
+        }
+    }
+    return true;
+}
+
+/* ===== Tables ===== */
+
+/* First matching entry wins: state (or any), event, guard */
+static const TrxTransition s_table[] = {
+    { TRX_ANY,         TRX_EV_REPLY,        NULL,               a_store_reply,   TRX_SAME        },
+
+    /* Stale S9 while idle: close it like a finished sale */
+    { TRX_IDLE,        TRX_EV_STATUS,       g_nozzle_back,      a_send_end,      TRX_CLOSING     },
+    { TRX_IDLE,        TRX_EV_START_VOLUME, g_can_authorise,    a_preset_volume, TRX_PRESET_SENT },
+    { TRX_IDLE,        TRX_EV_START_MONEY,  g_can_authorise,    a_preset_money,  TRX_PRESET_SENT },
+
+    { TRX_PRESET_SENT, TRX_EV_STATUS,       g_armed,            NULL,            TRX_ARMED       },
+    /* Nozzle lifted between two polls: S3 never seen */
+    { TRX_PRESET_SENT, TRX_EV_STATUS,       g_flowing,          NULL,            TRX_DISPENSING  },
+    /* Whole sale between two polls: closed like any other, S9 then
+       sends 'N' from COMPLETE */
+    { TRX_PRESET_SENT, TRX_EV_STATUS,       g_sale_end,         NULL,            TRX_COMPLETE    },
+    { TRX_PRESET_SENT, TRX_EV_STATUS,       g_nozzle_back,      NULL,            TRX_COMPLETE    },
+    { TRX_PRESET_SENT, TRX_EV_TIMEOUT,      NULL,               a_drop_preset,   TRX_CLOSING     },
+    { TRX_PRESET_SENT, TRX_EV_CANCEL,       NULL,               a_withdraw,      TRX_CLOSING     },
+
+    { TRX_ARMED,       TRX_EV_STATUS,       g_flowing,          NULL,            TRX_DISPENSING  },
+    { TRX_ARMED,       TRX_EV_STATUS,       g_sale_end,         NULL,            TRX_COMPLETE    },
+    { TRX_ARMED,       TRX_EV_STATUS,       g_nozzle_back,      NULL,            TRX_COMPLETE    },
+    { TRX_ARMED,       TRX_EV_STATUS,       g_closed,           a_auth_dropped,  TRX_IDLE        },
+    { TRX_ARMED,       TRX_EV_TIMEOUT,      NULL,               a_drop_preset,   TRX_CLOSING     },
+    { TRX_ARMED,       TRX_EV_CANCEL,       NULL,               a_withdraw,      TRX_CLOSING     },
+
+    { TRX_DISPENSING,  TRX_EV_STATUS,       g_sale_end,         NULL,            TRX_COMPLETE    },
+    /* S8 missed between two polls */
+    { TRX_DISPENSING,  TRX_EV_STATUS,       g_nozzle_back,      NULL,            TRX_COMPLETE    },
+    { TRX_DISPENSING,  TRX_EV_TIMEOUT,      NULL,               a_poll_rt,       TRX_SAME        },
+    { TRX_DISPENSING,  TRX_EV_PAUSE,        NULL,               a_stop,          TRX_PAUSED      },
+    { TRX_DISPENSING,  TRX_EV_CANCEL,       NULL,               a_send_end,      TRX_CLOSING     },
+
+    /* The pump may end a stopped sale itself. No flow row: the S4 from
+       before the Stop would resume at once; a sale resumed at the pump
+       still ends here with S8/S9. */
+    { TRX_PAUSED,      TRX_EV_STATUS,       g_sale_end,         NULL,            TRX_COMPLETE    },
+    { TRX_PAUSED,      TRX_EV_STATUS,       g_nozzle_back,      NULL,            TRX_COMPLETE    },
+    { TRX_PAUSED,      TRX_EV_RESUME,       NULL,               a_resume,        TRX_DISPENSING  },
+    { TRX_PAUSED,      TRX_EV_CANCEL,       NULL,               a_send_end,      TRX_CLOSING     },
+
+    { TRX_COMPLETE,    TRX_EV_STATUS,       g_nozzle_back,      a_send_end,      TRX_CLOSING     },
+    { TRX_COMPLETE,    TRX_EV_TIMEOUT,      NULL,               a_read_final,    TRX_SAME        },
+    { TRX_COMPLETE,    TRX_EV_START_VOLUME, NULL,               a_queue_preset,  TRX_SAME        },
+    { TRX_COMPLETE,    TRX_EV_START_MONEY,  NULL,               a_queue_preset,  TRX_SAME        },
+    /* First Cancel takes back the queued preset, the next one ends the sale */
+    { TRX_COMPLETE,    TRX_EV_CANCEL,       g_queued,           a_unqueue,       TRX_SAME        },
+    { TRX_COMPLETE,    TRX_EV_CANCEL,       NULL,               a_send_end,      TRX_CLOSING     },
+
+    { TRX_CLOSING,     TRX_EV_STATUS,       g_closed,           a_finish,        TRX_IDLE        },
+    { TRX_CLOSING,     TRX_EV_TIMEOUT,      g_still_open,       a_send_end,      TRX_SAME        },
+    { TRX_CLOSING,     TRX_EV_TIMEOUT,      g_pump_idle,        a_finish_idle,   TRX_IDLE        },
+    { TRX_CLOSING,     TRX_EV_START_VOLUME, NULL,               a_queue_preset,  TRX_SAME        },
+    { TRX_CLOSING,     TRX_EV_START_MONEY,  NULL,               a_queue_preset,  TRX_SAME        },
+    { TRX_CLOSING,     TRX_EV_CANCEL,       g_queued,           a_unqueue,       TRX_SAME        },
+};
+
+/* Per-state timer, armed on entry (0 = no timer) */
+static const uint32_t s_state_timeout_ms[TRX_STATE_COUNT] = {
+    [TRX_PRESET_SENT] = TRX_FSM_PRESET_TIMEOUT_MS,
+    [TRX_ARMED]       = TRX_FSM_ARMED_TIMEOUT_MS,
+    [TRX_DISPENSING]  = TRX_FSM_RT_POLL_MS,
+    [TRX_COMPLETE]    = TRX_FSM_FINAL_DELAY_MS,
+    [TRX_CLOSING]     = TRX_FSM_CLOSE_RETRY_MS,
+};
+
+static uint32_t trxfsm_timeout(const TransactionFSM *fsm)
+{
+    if (fsm->state == TRX_DISPENSING) return trxfsm_rt_interval(fsm);
+    if (fsm->state == TRX_COMPLETE) {
+        if (!trxfsm_final_step(fsm)) return 0u;
+        if (fsm->t_tries != 0u) return TRX_FSM_FINAL_RETRY_MS;
+    }
+    return s_state_timeout_ms[fsm->state];
+}
+
+/* Phase reached by entering a state (see trx_metrics.h) */
+static const uint8_t s_state_phase[TRX_STATE_COUNT] = {
+    [TRX_IDLE]        = TRX_PH_COUNT,
+    [TRX_PRESET_SENT] = TRX_PH_PRESET,
+    [TRX_ARMED]       = TRX_PH_ARMED,
+    [TRX_DISPENSING]  = TRX_PH_FLOW,
+    [TRX_PAUSED]      = TRX_PH_COUNT,
+    [TRX_COMPLETE]    = TRX_PH_END,
+    [TRX_CLOSING]     = TRX_PH_END_SENT,
+};
+
+/* State entry: phase stamps (a new sale starts at the preset, one that
+   went back to idle without closing is dropped), and fresh flow tracking
+   for each dispensing run (incl. resume) */
+static void trxfsm_enter(TransactionFSM *fsm)
+{
+    if (fsm->state == TRX_IDLE || fsm->state == TRX_PRESET_SENT) {
+        TrxMetrics_Reset(&fsm->metrics);
+    }
+    if (s_state_phase[fsm->state] != TRX_PH_COUNT) {
+        TrxMetrics_Stamp(&fsm->metrics, (TrxPhase)s_state_phase[fsm->state], HAL_GetTick());
+    }
+
+    if (fsm->state == TRX_COMPLETE) fsm->end_ms = HAL_GetTick();
+
+    if (fsm->state == TRX_DISPENSING) {
+        fsm->flow_mdL_s = 0u;
+        fsm->have_sample = false;
+        fsm->rt_bank_ms = 0u;
+        fsm->last_rt_poll_ms = HAL_GetTick();
+        fsm->plan_pos = 0u;
+    }
+}
+
+/* ===== Core ===== */
+
+bool TrxFSM_Dispatch(TransactionFSM *fsm, const TrxEvent *ev)
+{
+    if (!fsm || !ev) return false;
+
+    if (ev->type == TRX_EV_STATUS) {
+        fsm->pump_status = ev->status;
+        fsm->deferred = false;
+        if (ev->status == 9) TrxMetrics_Stamp(&fsm->metrics, TRX_PH_NOZZLE_BACK, HAL_GetTick());
+    }
+
+    for (uint8_t i = 0; i < (uint8_t)(sizeof(s_table) / sizeof(s_table[0])); i++) {
+        const TrxTransition *t = &s_table[i];
+        if (t->event != (uint8_t)ev->type) continue;
+        if (t->state != TRX_ANY && t->state != (uint8_t)fsm->state) continue;
+        if (t->guard && !t->guard(fsm, ev)) continue;
+
+        if (t->action && !t->action(fsm, ev)) {
+            /* Link busy: status work is retried from Task, timers soon after;
+               user commands simply report failure */
+            if (ev->type == TRX_EV_STATUS) {
+                fsm->deferred = true;
+            } else if (ev->type == TRX_EV_TIMEOUT) {
+                trxfsm_arm(fsm, TRX_FSM_RETRY_MS);
+            }
+            return false;
+        }
+
+        if (t->next == TRX_SAME || t->next == (uint8_t)fsm->state) {
+            if (ev->type == TRX_EV_TIMEOUT) {
+                trxfsm_arm(fsm, trxfsm_timeout(fsm));
+            }
+            return true;
+        }
+
+        TrxState prev = fsm->state;
+        fsm->state = (TrxState)t->next;
+        trxfsm_record(fsm, TRX_REC_TRANSITION, prev, fsm->state);
+        trxfsm_enter(fsm);
+        trxfsm_arm(fsm, trxfsm_timeout(fsm));
+
+        /* New state may already match the current pump status; no status
+           pair leads back, so this settles after one or two steps */
+        TrxEvent settle = { .type = TRX_EV_STATUS, .status = fsm->pump_status };
+        (void)TrxFSM_Dispatch(fsm, &settle);
+        return true;
+    }
+
+    /* Timer with no matching entry (guard false): keep it running */
+    if (ev->type == TRX_EV_TIMEOUT) {
+        trxfsm_arm(fsm, trxfsm_timeout(fsm));
+    }
+    return false;
+}
+
+/* PumpMgr notification: status changes of our pump, and the totalizer
+   once the sale has ended (any reading then is the one after the sale) */
+static void trxfsm_on_pump_change(void *ctx, const PumpMgrNotify *n)
+{
+    TransactionFSM *fsm = (TransactionFSM *)ctx;
+    if (!fsm || !n) return;
+
+    if (n->what & PUMP_MGR_NOTIFY_TOTALIZER) {
+        if (n->nozzle_idx == 1u && (fsm->state == TRX_COMPLETE || fsm->state == TRX_CLOSING)) {
+            fsm->tot_after_valid = true;
+            fsm->tot_after_cL = n->totalizer;
+        }
+        return;
+    }
+    if (!(n->what & PUMP_MGR_NOTIFY_STATUS)) return;
+
+    TrxEvent ev = { .type = TRX_EV_STATUS, .status = n->status };
+    (void)TrxFSM_Dispatch(fsm, &ev);
+}
+
+/* Reply to our own request, from our completion slot. Failures need no
+   handling here: the state timers repeat what is still needed. */
+static void trxfsm_collect(TransactionFSM *fsm)
+{
+    if (!fsm->done.done) return;
+
+    GKL_Frame fr = fsm->done.frame;
+    GKL_Result r = fsm->done.result;
+    fsm->done.done = 0u;
+    if (r != GKL_OK) return;
+
+    /* Manager learns the pump is alive (and logs the frame) */
+    PumpProtoGKL_ReportReply(fsm->gkl, &fr);
+
+    TrxEvent ev = { .type = TRX_EV_REPLY, .cmd = (uint8_t)fr.cmd };
+    uint8_t noz = 0u;
+    bool ok = true;
+    if (fr.cmd == 'L') ok = PumpResp_ParseRealtimeVolume(&fr, &noz, &ev.value);
+    else if (fr.cmd == 'R') ok = PumpResp_ParseRealtimeMoney(&fr, &noz, &ev.value);
+    else if (fr.cmd == 'T') ok = PumpResp_ParseTransaction(&fr, &noz, &ev.value, &ev.money, &ev.price);
+    else if (fr.cmd == 'C') {
+        ok = PumpResp_ParseTotalizer(&fr, &noz, &ev.value) && noz != 0u;
+        if (ok) PumpMgr_PutTotalizer(fsm->mgr, fsm->pump_id, noz, ev.value);
+        ev.nozzle = noz;
+    }
+    if (ok) (void)TrxFSM_Dispatch(fsm, &ev);
+}
+
+bool TrxFSM_Init(TransactionFSM *fsm, uint8_t pump_id, PumpMgr *mgr, PumpProtoGKL *gkl)
+{
+    if (!fsm) return false;
     memset(fsm, 0, sizeof(*fsm));
     fsm->pump_id = pump_id;
     fsm->mgr = mgr;
     fsm->gkl = gkl;
     fsm->state = TRX_IDLE;
+    fsm->poll_plan = TRX_FSM_POLL_PLAN;
+    TrxMetrics_Init(&fsm->metrics);
+
+    if (mgr) {
+        PumpSnapshot dev;
+        if (PumpMgr_Snapshot(mgr, pump_id, &dev)) {
+            fsm->pump_status = dev.status;
+        }
+        fsm->sub_handle = PumpMgr_Subscribe(mgr, pump_id,
+                                            PUMP_MGR_NOTIFY_STATUS | PUMP_MGR_NOTIFY_TOTALIZER,
+                                            trxfsm_on_pump_change, fsm);
+        if (fsm->sub_handle == 0) {
+            char msg[48];
+            snprintf(msg, sizeof(msg), "TRK%u: no subscription slot", (unsigned)pump_id);
+            CDC_Log(msg);
+            return false;
+        }
+    }
+    return true;
 }
 
 void TrxFSM_Task(TransactionFSM *fsm)
 {
     if (!fsm || !fsm->gkl || !fsm->mgr) return;
-    
-    uint32_t now = HAL_GetTick();
-    GKL_Link *gkl = &fsm->gkl->link;
-    const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
-    if (!dev) return;
-    
-    /* Process GKL responses */
-    if (GKL_HasResponse(gkl)) {
-        GKL_Frame resp;
-        if (GKL_GetResponse(gkl, &resp)) {
-            if (resp.cmd == 'L') {
-                uint8_t nozzle;
-                uint32_t volume_dL;
-                if (PumpResp_ParseRealtimeVolume(&resp, &nozzle, &volume_dL)) {
-                    fsm->rt_volume_dL = volume_dL;
-                }
-            }
-            else if (resp.cmd == 'R') {
-                uint8_t nozzle;
-                uint32_t money;
-                if (PumpResp_ParseRealtimeMoney(&resp, &nozzle, &money)) {
-                    fsm->rt_money = money;
-                }
-            }
-            else if (resp.cmd == 'C') {
-                uint8_t nozzle;
-                uint32_t totalizer_dL;
-                if (PumpResp_ParseTotalizer(&resp, &nozzle, &totalizer_dL)) {
-                    fsm->totalizer_dL = totalizer_dL;
-                }
-            }
-        }
+
+    trxfsm_collect(fsm);
+
+    /* Status transition that found the link busy */
+    if (fsm->deferred) {
+        TrxEvent ev = { .type = TRX_EV_STATUS, .status = fsm->pump_status };
+        (void)TrxFSM_Dispatch(fsm, &ev);
     }
-    
-    /* State machine transitions */
-    switch (fsm->state) {
-        case TRX_IDLE:
-            /* Auto-cleanup: if pump shows S90 but we're idle, send N to close */
-            if (dev->status == 9 && gkl->state == GKL_STATE_IDLE) {
-                PumpTrans_End(gkl, dev->ctrl_addr, dev->slave_addr);
-            }
-            break;
-            
-        case TRX_PRESET_SENT:
-            if (dev->status == 3) {
-                fsm->state = TRX_ARMED;
-            }
-            break;
-            
-        case TRX_ARMED:
-            if (dev->status == 4 || dev->status == 6) {
-                fsm->state = TRX_DISPENSING;
-            }
-            break;
-            
-        case TRX_DISPENSING:
-            /* Poll realtime data every 500ms */
-            if ((now - fsm->last_poll_ms) > 500 && gkl->state == GKL_STATE_IDLE) {
-                fsm->last_poll_ms = now;
-                PumpTrans_PollRealtimeVolume(gkl, dev->ctrl_addr, dev->slave_addr, 1);
-            }
-            
-            if (dev->status == 8) {
-                fsm->state = TRX_COMPLETE;
-            }
-            break;
-            
-        case TRX_PAUSED:
-            /* Waiting for resume or cancel */
-            break;
-            
-        case TRX_COMPLETE:
-            /* Auto-close on S90 (nozzle returned) */
-            if (dev->status == 9 && gkl->state == GKL_STATE_IDLE) {
-                PumpTrans_End(gkl, dev->ctrl_addr, dev->slave_addr);
-                fsm->state = TRX_CLOSING;
-            }
-            break;
-            
-        case TRX_CLOSING:
-            if (dev->status == 1) {
-                fsm->state = TRX_IDLE;
-                fsm->rt_volume_dL = 0;
-                fsm->rt_money = 0;
-            }
-            break;
+
+    if (fsm->timer_armed && (int32_t)(HAL_GetTick() - fsm->timer_deadline_ms) >= 0) {
+        fsm->timer_armed = false;
+        TrxEvent ev = { .type = TRX_EV_TIMEOUT };
+        (void)TrxFSM_Dispatch(fsm, &ev);
+    }
+
+    /* Queued preset: sent once the pump is back at S1. Busy link or a
+       price switch-over keeps it queued for the next pass. */
+    if (fsm->next_valid && fsm->state == TRX_IDLE && fsm->pump_status == 1u) {
+        TrxEvent ev = { .type = (TrxEventType)fsm->next_type, .value = fsm->next_value };
+        if (TrxFSM_Dispatch(fsm, &ev)) fsm->next_valid = false;
     }
 }
 
+/* ===== User commands ===== */
+
+static bool trxfsm_command(TransactionFSM *fsm, TrxEventType type, uint32_t value)
+{
+    TrxEvent ev = { .type = type, .value = value };
+    return TrxFSM_Dispatch(fsm, &ev);
+}
+
 bool TrxFSM_StartVolume(TransactionFSM *fsm, uint32_t volume_dL)
 {
-    if (!fsm || !fsm->gkl || fsm->state != TRX_IDLE) return false;
-    
-    const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
-    if (!dev) return false;
-    
-    GKL_Link *gkl = &fsm->gkl->link;
-    if (gkl->state != GKL_STATE_IDLE) return false;
-    
-    fsm->preset_volume_dL = volume_dL;
-    fsm->rt_volume_dL = 0;
-    fsm->rt_money = 0;
-    
-    if (PumpTrans_PresetVolume(gkl, dev->ctrl_addr, dev->slave_addr, 1, volume_dL, dev->price)) {
-        fsm->state = TRX_PRESET_SENT;
-        fsm->last_poll_ms = HAL_GetTick();
-        return true;
-    }
-    return false;
+    return trxfsm_command(fsm, TRX_EV_START_VOLUME, volume_dL);
 }
 
 bool TrxFSM_StartMoney(TransactionFSM *fsm, uint32_t money)
 {
-    if (!fsm || !fsm->gkl || fsm->state != TRX_IDLE) return false;
-    
-    const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
-    if (!dev) return false;
-    
-    GKL_Link *gkl = &fsm->gkl->link;
-    if (gkl->state != GKL_STATE_IDLE) return false;
-    
-    fsm->preset_money = money;
-    fsm->rt_volume_dL = 0;
-    fsm->rt_money = 0;
-    
-    if (PumpTrans_PresetMoney(gkl, dev->ctrl_addr, dev->slave_addr, 1, money, dev->price)) {
-        fsm->state = TRX_PRESET_SENT;
-        fsm->last_poll_ms = HAL_GetTick();
-        return true;
-    }
-    return false;
+    return trxfsm_command(fsm, TRX_EV_START_MONEY, money);
 }
 
 bool TrxFSM_Pause(TransactionFSM *fsm)
 {
-    if (!fsm || !fsm->gkl || fsm->state != TRX_DISPENSING) return false;
-    
-    const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
-    if (!dev) return false;
-    
-    GKL_Link *gkl = &fsm->gkl->link;
-    if (gkl->state != GKL_STATE_IDLE) return false;
-    
-    if (PumpTrans_Stop(gkl, dev->ctrl_addr, dev->slave_addr)) {
-        fsm->state = TRX_PAUSED;
-        return true;
-    }
-    return false;
+    return trxfsm_command(fsm, TRX_EV_PAUSE, 0);
 }
 
 bool TrxFSM_Resume(TransactionFSM *fsm)
 {
-    if (!fsm || !fsm->gkl || fsm->state != TRX_PAUSED) return false;
-    
-    const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
-    if (!dev) return false;
-    
-    GKL_Link *gkl = &fsm->gkl->link;
-    if (gkl->state != GKL_STATE_IDLE) return false;
-    
-    if (PumpTrans_Resume(gkl, dev->ctrl_addr, dev->slave_addr)) {
-        fsm->state = TRX_DISPENSING;
-        return true;
-    }
-    return false;
+    return trxfsm_command(fsm, TRX_EV_RESUME, 0);
 }
 
 bool TrxFSM_Cancel(TransactionFSM *fsm)
 {
-    if (!fsm || !fsm->gkl) return false;
-    
-    if (fsm->state == TRX_IDLE || fsm->state == TRX_CLOSING) return false;
-    
-    const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
-    if (!dev) return false;
-    
-    GKL_Link *gkl = &fsm->gkl->link;
-    if (gkl->state != GKL_STATE_IDLE) return false;
-    
-    if (fsm->state == TRX_PRESET_SENT || fsm->state == TRX_ARMED) {
-        fsm->state = TRX_IDLE;
-        fsm->rt_volume_dL = 0;
-        fsm->rt_money = 0;
-        return true;
-    }
-    
-    if (PumpTrans_End(gkl, dev->ctrl_addr, dev->slave_addr)) {
-        fsm->state = TRX_CLOSING;
-        return true;
-    }
-    return false;
+    return trxfsm_command(fsm, TRX_EV_CANCEL, 0);
 }
 
 TrxState TrxFSM_GetState(TransactionFSM *fsm)
@@ -226,3 +846,73 @@ uint32_t TrxFSM_GetRealtimeMoney(TransactionFSM *fsm)
 {
     return fsm ? fsm->rt_money : 0;
 }
+
+/* Display volume in 1/1000 dL; local only, nothing is sent */
+static uint32_t trxfsm_display_mdL(TransactionFSM *fsm)
+{
+    uint64_t floor_mdL = (uint64_t)fsm->rt_volume_dL * FIXDEC_MDL_PER_DL;
+    if (fsm->state != TRX_DISPENSING || !fsm->have_sample || fsm->flow_mdL_s == 0u) {
+        return (floor_mdL > UINT32_MAX) ? UINT32_MAX : (uint32_t)floor_mdL;
+    }
+
+    uint32_t dt = HAL_GetTick() - fsm->last_sample_ms;
+    if (dt > TRX_FSM_DISPLAY_HORIZON_MS) dt = TRX_FSM_DISPLAY_HORIZON_MS;
+
+    uint64_t est = trxfsm_project_mdL(fsm, dt);
+    if (est < fsm->disp_mdL) est = fsm->disp_mdL;
+    if (fsm->target_dL != 0u && est > (uint64_t)fsm->target_dL * FIXDEC_MDL_PER_DL) {
+        est = (uint64_t)fsm->target_dL * FIXDEC_MDL_PER_DL;
+    }
+    if (est < floor_mdL) est = floor_mdL;
+    if (est > UINT32_MAX) est = UINT32_MAX;
+
+    fsm->disp_mdL = (uint32_t)est;
+    return fsm->disp_mdL;
+}
+
+uint32_t TrxFSM_GetDisplayVolume(TransactionFSM *fsm)
+{
+    return fsm ? trxfsm_display_mdL(fsm) / FIXDEC_MDL_PER_DL : 0;
+}
+
+uint32_t TrxFSM_GetDisplayMoney(TransactionFSM *fsm)
+{
+    if (!fsm) return 0;
+    if (fsm->state != TRX_DISPENSING || fsm->money_mismatch || fsm->sale_price == 0u) return fsm->rt_money;
+
+    uint32_t money = trxfsm_money_of(fsm, trxfsm_display_mdL(fsm));
+    if (fsm->preset_is_money && money > fsm->preset_money) money = fsm->preset_money;
+    return (money > fsm->rt_money) ? money : fsm->rt_money;
+}
+
+bool TrxFSM_GetQueuedPreset(const TransactionFSM *fsm, bool *is_money, uint32_t *value)
+{
+    if (!fsm || !fsm->next_valid) return false;
+    if (is_money) *is_money = (fsm->next_type == TRX_EV_START_MONEY);
+    if (value) *value = fsm->next_value;
+    return true;
+}
+
+void TrxFSM_SetRecorder(TransactionFSM *fsm, TrxRecordFn fn, void *ctx)
+{
+    if (!fsm) return;
+    fsm->record_fn = fn;
+    fsm->record_ctx = ctx;
+}
+
+void TrxFSM_SetPollPlan(TransactionFSM *fsm, const char *plan)
+{
+    if (!fsm) return;
+    fsm->poll_plan = (plan && plan[0] != '\0') ? plan : TRX_FSM_POLL_PLAN;
+    fsm->plan_pos = 0u;
+}
+
+uint32_t TrxFSM_GetFlowRate(TransactionFSM *fsm)
+{
+    return (fsm && fsm->state == TRX_DISPENSING) ? fsm->flow_mdL_s : 0;
+}
+
+const TrxMetrics *TrxFSM_GetMetrics(const TransactionFSM *fsm)
+{
+    return fsm ? &fsm->metrics : NULL;
+}
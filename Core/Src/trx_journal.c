@@ -0,0 +1,344 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_journal.c
+  * @brief   Append-only transaction journal in the settings EEPROM.
+  *
+  * Record (32 bytes, little-endian):
+  *  [0]  u32 seq (consecutive, slot i of a lap holds seq0 + i)
+  *  [4]  u8  type, pump_id, from, to
+  *  [8]  u32 volume_dL
+  *  [12] u32 money
+  *  [16] u32 preset
+  *  [20] u16 price (4 BCD digits on the wire, FIXDEC_BCD4_MAX fits)
+  *  [22] u8  flags (bit0: preset is money, bits 1..7: recon)
+  *  [23] u8  pump status
+  *  [24] u32 sale id (SALE, UPLOAD_ACK), else time_ms
+  *  [28] u32 crc32([0..27])
+  *
+  * Recovery: slots 0..h of the current lap hold seq0..seq0+h; any later slot
+  * is erased, torn or from the previous lap, so "slot i valid with
+  * seq0 + i" is true up to the head and false after it -> binary search.
+  * A failed write is retried in the same slot with the same seq, so a torn
+  * record is always overwritten before the log goes past it.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#include "trx_journal.h"
+#include "crc32.h"
+#include <string.h>
+
+/* Singleton pointer for HAL I2C callbacks dispatching */
+static TrxJournal *s_journal_singleton = NULL;
+
+static uint32_t rd_u32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] |
+           ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static void wr_u32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v & 0xFFu);
+    p[1] = (uint8_t)((v >> 8) & 0xFFu);
+    p[2] = (uint8_t)((v >> 16) & 0xFFu);
+    p[3] = (uint8_t)((v >> 24) & 0xFFu);
+}
+
+/* ---------------- Record image ---------------- */
+static bool journal_has_sale_id(uint8_t type)
+{
+    return type == TRX_REC_SALE || type == TRX_REC_UPLOAD_ACK;
+}
+
+static void journal_pack(const TrxJournalEntry *e, uint8_t *img)
+{
+    wr_u32_le(&img[0], e->seq);
+    img[4] = e->rec.type;
+    img[5] = e->rec.pump_id;
+    img[6] = e->rec.from;
+    img[7] = e->rec.to;
+    wr_u32_le(&img[8], e->rec.volume_dL);
+    wr_u32_le(&img[12], e->rec.money);
+    wr_u32_le(&img[16], e->rec.preset);
+    img[20] = (uint8_t)(e->rec.price & 0xFFu);
+    img[21] = (uint8_t)((e->rec.price >> 8) & 0xFFu);
+    img[22] = (uint8_t)((e->rec.preset_money ? 0x01u : 0x00u) | (uint8_t)(e->rec.recon << 1));
+    img[23] = e->rec.pump_status;
+    wr_u32_le(&img[24], journal_has_sale_id(e->rec.type) ? e->rec.sale_id : e->time_ms);
+    wr_u32_le(&img[28], CRC32_Calc(img, TRX_JOURNAL_REC_SIZE - 4u));
+}
+
+static bool journal_unpack(const uint8_t *img, TrxJournalEntry *e)
+{
+    if (CRC32_Calc(img, TRX_JOURNAL_REC_SIZE - 4u) != rd_u32_le(&img[28])) return false;
+
+    memset(e, 0, sizeof(*e));
+    e->seq = rd_u32_le(&img[0]);
+    e->rec.type = img[4];
+    e->rec.pump_id = img[5];
+    e->rec.from = img[6];
+    e->rec.to = img[7];
+    e->rec.volume_dL = rd_u32_le(&img[8]);
+    e->rec.money = rd_u32_le(&img[12]);
+    e->rec.preset = rd_u32_le(&img[16]);
+    e->rec.price = (uint32_t)img[20] | ((uint32_t)img[21] << 8);
+    e->rec.preset_money = (img[22] & 0x01u) != 0u;
+    e->rec.recon = (uint8_t)(img[22] >> 1);
+    e->rec.pump_status = img[23];
+    if (journal_has_sale_id(e->rec.type)) e->rec.sale_id = rd_u32_le(&img[24]);
+    else                                  e->time_ms = rd_u32_le(&img[24]);
+    return e->rec.type != 0u;
+}
+
+static uint16_t journal_addr(uint16_t slot)
+{
+    return (uint16_t)(TRX_JOURNAL_BASE_ADDR + (uint32_t)slot * TRX_JOURNAL_REC_SIZE);
+}
+
+/* Blocking read of one slot (startup only) */
+static bool journal_read(TrxJournal *j, uint16_t slot, TrxJournalEntry *e)
+{
+    uint8_t img[TRX_JOURNAL_REC_SIZE];
+
+    if (HAL_I2C_Mem_Read(j->bus->hi2c,
+                         SETTINGS_EEPROM_I2C_ADDR,
+                         journal_addr(slot),
+                         SETTINGS_EEPROM_MEMADD_SIZE,
+                         img,
+                         TRX_JOURNAL_REC_SIZE,
+                         20u) != HAL_OK)
+    {
+        return false;
+    }
+    return journal_unpack(img, e);
+}
+
+/* ---------------- API ---------------- */
+
+void TrxJournal_Init(TrxJournal *j, Settings *bus)
+{
+    if (j == NULL) return;
+    memset(j, 0, sizeof(*j));
+
+    j->bus = bus;
+    j->next_seq = 1u;
+    s_journal_singleton = j;
+}
+
+bool TrxJournal_Recover(TrxJournal *j)
+{
+    if (j == NULL || j->bus == NULL || j->bus->hi2c == NULL) return false;
+
+    TrxJournalEntry e;
+    j->head = 0u;
+    j->next_seq = 1u;
+
+    if (!journal_read(j, 0u, &e))
+    {
+        /* Empty, or a torn write at slot 0 right after a wrap */
+        if (journal_read(j, (uint16_t)(TRX_JOURNAL_CAPACITY - 1u), &e))
+        {
+            j->next_seq = e.seq + 1u;
+            return true;
+        }
+        return false;
+    }
+
+    uint32_t seq0 = e.seq;
+    uint16_t lo = 0u;
+    uint16_t hi = (uint16_t)(TRX_JOURNAL_CAPACITY - 1u);
+
+    /* Last slot of the current lap */
+    while (lo < hi)
+    {
+        uint16_t mid = (uint16_t)((lo + hi + 1u) / 2u);
+        if (journal_read(j, mid, &e) && e.seq == seq0 + mid) lo = mid;
+        else hi = (uint16_t)(mid - 1u);
+    }
+
+    j->head = (uint16_t)((lo + 1u) % TRX_JOURNAL_CAPACITY);
+    j->next_seq = seq0 + lo + 1u;
+    return true;
+}
+
+uint16_t TrxJournal_Replay(TrxJournal *j, uint16_t max, TrxJournalVisitFn fn, void *ctx)
+{
+    if (j == NULL || fn == NULL || j->bus == NULL || j->bus->hi2c == NULL) return 0u;
+
+    /* Records on disk: next_seq - 1, at most one lap */
+    uint32_t count = j->next_seq - 1u;
+    if (count > TRX_JOURNAL_CAPACITY) count = TRX_JOURNAL_CAPACITY;
+    if (count > max) count = max;
+
+    uint16_t slot = (uint16_t)((j->head + TRX_JOURNAL_CAPACITY - count) % TRX_JOURNAL_CAPACITY);
+    uint32_t seq = j->next_seq - count;
+    uint16_t n = 0u;
+
+    for (uint32_t k = 0u; k < count; k++, seq++)
+    {
+        TrxJournalEntry e;
+        bool ok = journal_read(j, slot, &e) && e.seq == seq;
+        slot = (uint16_t)((slot + 1u) % TRX_JOURNAL_CAPACITY);
+        if (!ok) continue;
+
+        n++;
+        if (!fn(ctx, &e)) break;
+    }
+    return n;
+}
+
+uint16_t TrxJournal_ReplayBack(TrxJournal *j, uint16_t max, TrxJournalVisitFn fn, void *ctx)
+{
+    if (j == NULL || fn == NULL || j->bus == NULL || j->bus->hi2c == NULL) return 0u;
+
+    uint16_t slot = j->head;
+    uint32_t seq = j->next_seq;
+    uint16_t n = 0u;
+
+    while (n < max && n < TRX_JOURNAL_CAPACITY && seq > 1u)
+    {
+        slot = (uint16_t)((slot + TRX_JOURNAL_CAPACITY - 1u) % TRX_JOURNAL_CAPACITY);
+        seq--;
+
+        TrxJournalEntry e;
+        if (!journal_read(j, slot, &e) || e.seq != seq) break;
+
+        n++;
+        if (!fn(ctx, &e)) break;
+    }
+    return n;
+}
+
+void TrxJournal_Append(void *ctx, const TrxRecord *rec)
+{
+    TrxJournal *j = (TrxJournal *)ctx;
+    if (j == NULL || rec == NULL) return;
+
+    if (j->q_count >= TRX_JOURNAL_QUEUE_LEN)
+    {
+        j->dropped++;
+        return;
+    }
+
+    uint8_t idx = (uint8_t)((j->q_head + j->q_count) % TRX_JOURNAL_QUEUE_LEN);
+    TrxJournalEntry *e = &j->q[idx];
+    e->seq = 0u;
+    e->time_ms = HAL_GetTick();
+    e->rec = *rec;
+    j->q_count++;
+}
+
+uint8_t TrxJournal_Pending(const TrxJournal *j)
+{
+    return (j != NULL) ? j->q_count : 0u;
+}
+
+/* Record at the queue head is done (written or given up) */
+static void journal_pop(TrxJournal *j)
+{
+    j->q_head = (uint8_t)((j->q_head + 1u) % TRX_JOURNAL_QUEUE_LEN);
+    j->q_count--;
+    j->wr_tries = 0u;
+}
+
+static void journal_write_failed(TrxJournal *j)
+{
+    j->wr_wait_ready = 0u;
+    if (++j->wr_tries >= TRX_JOURNAL_RETRIES)
+    {
+        j->dropped++;
+        journal_pop(j);
+    }
+}
+
+void TrxJournal_Task(TrxJournal *j)
+{
+    if (j == NULL || j->bus == NULL || j->bus->hi2c == NULL) return;
+
+    /* 1) Wait for HAL TX complete callback */
+    if (j->wr_inflight) return;
+
+    if (j->wr_failed)
+    {
+        j->wr_failed = 0u;
+        journal_write_failed(j);
+        return;
+    }
+
+    /* 2) Wait EEPROM internal write cycle, then the record is durable */
+    if (j->wr_wait_ready)
+    {
+        uint32_t now = HAL_GetTick();
+        if (j->wr_ready_start_ms == 0u)
+        {
+            j->wr_ready_start_ms = now;
+        }
+
+        if (HAL_I2C_IsDeviceReady(j->bus->hi2c, SETTINGS_EEPROM_I2C_ADDR, 1u, 2u) == HAL_OK)
+        {
+            j->wr_wait_ready = 0u;
+            j->head = (uint16_t)((j->head + 1u) % TRX_JOURNAL_CAPACITY);
+            j->next_seq++;
+            j->written++;
+            journal_pop(j);
+        }
+        else if ((now - j->wr_ready_start_ms) > 50u)
+        {
+            journal_write_failed(j);
+        }
+        return;
+    }
+
+    /* 3) Next record; a settings save owns the EEPROM until it is done */
+    if (j->q_count == 0u || j->bus->wr_active) return;
+
+    TrxJournalEntry *e = &j->q[j->q_head];
+    e->seq = j->next_seq;
+    journal_pack(e, j->wr_buf);
+
+    HAL_StatusTypeDef st = HAL_I2C_Mem_Write_IT(j->bus->hi2c,
+                                                SETTINGS_EEPROM_I2C_ADDR,
+                                                journal_addr(j->head),
+                                                SETTINGS_EEPROM_MEMADD_SIZE,
+                                                j->wr_buf,
+                                                TRX_JOURNAL_REC_SIZE);
+    if (st == HAL_BUSY) return;
+    if (st != HAL_OK)
+    {
+        journal_write_failed(j);
+        return;
+    }
+
+    j->wr_inflight = 1u;
+}
+
+/* ---------------- HAL I2C callbacks (forwarded by settings.c) ---------------- */
+
+void TrxJournal_OnI2CTxCplt(I2C_HandleTypeDef *hi2c)
+{
+    TrxJournal *j = s_journal_singleton;
+    if (j == NULL || j->bus == NULL || hi2c != j->bus->hi2c) return;
+
+    if (j->wr_inflight)
+    {
+        j->wr_inflight = 0u;
+        j->wr_wait_ready = 1u;
+        j->wr_ready_start_ms = 0u;
+    }
+}
+
+void TrxJournal_OnI2CError(I2C_HandleTypeDef *hi2c)
+{
+    TrxJournal *j = s_journal_singleton;
+    if (j == NULL || j->bus == NULL || hi2c != j->bus->hi2c) return;
+
+    if (j->wr_inflight)
+    {
+        j->wr_inflight = 0u;
+        j->wr_failed = 1u;
+    }
+}
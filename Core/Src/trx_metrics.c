@@ -0,0 +1,112 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_metrics.c
+  * @brief   Per-pump sale timing: phase timestamps and interval histograms.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#include "trx_metrics.h"
+#include <string.h>
+
+/* Interval = stamp[to] - stamp[from] */
+typedef struct
+{
+    uint8_t from;
+    uint8_t to;
+} TrxMetricSpan;
+
+static const TrxMetricSpan s_span[TRX_MET_FLOW_RATE] = {
+    [TRX_MET_AUTHORISE]   = { TRX_PH_PRESET,      TRX_PH_ARMED       },
+    [TRX_MET_LIFT]        = { TRX_PH_ARMED,       TRX_PH_FLOW        },
+    [TRX_MET_FILL]        = { TRX_PH_FLOW,        TRX_PH_END         },
+    [TRX_MET_HANG_UP]     = { TRX_PH_END,         TRX_PH_NOZZLE_BACK },
+    [TRX_MET_END_LATENCY] = { TRX_PH_NOZZLE_BACK, TRX_PH_END_SENT    },
+    [TRX_MET_CLOSE]       = { TRX_PH_END_SENT,    TRX_PH_CLOSED      },
+    [TRX_MET_SALE]        = { TRX_PH_PRESET,      TRX_PH_CLOSED      },
+};
+
+static const char *const s_name[TRX_MET_COUNT] = {
+    [TRX_MET_AUTHORISE]   = "AUTH",
+    [TRX_MET_LIFT]        = "LIFT",
+    [TRX_MET_FILL]        = "FILL",
+    [TRX_MET_HANG_UP]     = "HANG",
+    [TRX_MET_END_LATENCY] = "NLAT",
+    [TRX_MET_CLOSE]       = "CLOSE",
+    [TRX_MET_SALE]        = "SALE",
+    [TRX_MET_FLOW_RATE]   = "RATE",
+};
+
+static uint8_t metrics_bucket(uint32_t v)
+{
+    uint8_t b = 0u;
+    while (v > 1u && b < (TRX_METRICS_BUCKETS - 1u))
+    {
+        v >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void metrics_add(TrxMetricHist *h, uint32_t v)
+{
+    uint8_t b = metrics_bucket(v);
+    if (h->bucket[b] < 0xFFFFu) h->bucket[b]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max) h->max = v;
+}
+
+static bool metrics_has(const TrxMetrics *m, uint8_t phase)
+{
+    return (m->stamped & (1u << phase)) != 0u;
+}
+
+void TrxMetrics_Init(TrxMetrics *m)
+{
+    if (m == NULL) return;
+    memset(m, 0, sizeof(*m));
+}
+
+void TrxMetrics_Stamp(TrxMetrics *m, TrxPhase phase, uint32_t now_ms)
+{
+    if (m == NULL || phase >= TRX_PH_COUNT || metrics_has(m, (uint8_t)phase)) return;
+
+    m->stamp_ms[phase] = now_ms;
+    m->stamped |= (uint8_t)(1u << phase);
+}
+
+void TrxMetrics_Reset(TrxMetrics *m)
+{
+    if (m == NULL) return;
+    m->stamped = 0u;
+}
+
+void TrxMetrics_Close(TrxMetrics *m, uint32_t volume_dL)
+{
+    if (m == NULL) return;
+
+    for (uint8_t k = 0u; k < (uint8_t)TRX_MET_FLOW_RATE; k++)
+    {
+        const TrxMetricSpan *s = &s_span[k];
+        if (!metrics_has(m, s->from) || !metrics_has(m, s->to)) continue;
+        metrics_add(&m->hist[k], m->stamp_ms[s->to] - m->stamp_ms[s->from]);
+    }
+
+    if (metrics_has(m, TRX_PH_FLOW) && metrics_has(m, TRX_PH_END) && volume_dL != 0u)
+    {
+        uint32_t fill_ms = m->stamp_ms[TRX_PH_END] - m->stamp_ms[TRX_PH_FLOW];
+        if (fill_ms != 0u)
+        {
+            metrics_add(&m->hist[TRX_MET_FLOW_RATE], (uint32_t)(((uint64_t)volume_dL * 60000u) / fill_ms));
+        }
+    }
+
+    TrxMetrics_Reset(m);
+}
+
+const char *TrxMetrics_Name(TrxMetric met)
+{
+    return (met < TRX_MET_COUNT) ? s_name[met] : "?";
+}
@@ -0,0 +1,267 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_store.c
+  * @brief   In-RAM sales history with per-pump and time-range queries.
+  *
+  * Sale seq s (1, 2, ...) is stored at sale[s % CAPACITY]; the newest
+  * CAPACITY seqs are live. Pump p's n-th sale is pump_seq[p][n % DEPTH];
+  * an index entry whose seq has left the ring is dead. Both sequences are
+  * ordered by end_ms (ticks compared with wrap-around), so seeks are binary
+  * searches over positions. The compare only orders ticks less than 2^31
+  * apart, so time_seq is moved past sales more than TRX_STORE_TIME_SPAN_MS
+  * older than the newest; seeks treat those (and restored sales, all below
+  * time_seq) as dead. Seqs continue across reboots (seeded from the
+  * journal), so a seq between base_seq and next_seq may be a hole.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#include "trx_store.h"
+#include <string.h>
+
+/* a >= b on the wrapping tick counter */
+static bool store_time_ge(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) >= 0;
+}
+
+static const TrxSale *store_sale(const TrxStore *st, uint32_t seq)
+{
+    return &st->sale[seq % TRX_STORE_CAPACITY];
+}
+
+static bool store_indexed(uint8_t pump_id)
+{
+    return pump_id >= 1u && pump_id <= TRX_STORE_INDEX_PUMPS;
+}
+
+/* Oldest seq still in the ring and in the time span */
+static uint32_t store_time_oldest(const TrxStore *st)
+{
+    uint32_t oldest = TrxStore_OldestSeq(st);
+    return (st->time_seq > oldest) ? st->time_seq : oldest;
+}
+
+/* Sale seq behind a cursor position (0 = dead index entry) */
+static uint32_t store_pos_seq(const TrxStore *st, const TrxStoreCursor *c, uint32_t pos)
+{
+    if (!store_indexed(c->pump_id)) return pos;
+
+    uint32_t seq = st->pump_seq[c->pump_id - 1u][pos % TRX_STORE_INDEX_DEPTH];
+    return (seq >= store_time_oldest(st)) ? seq : 0u;
+}
+
+void TrxStore_Init(TrxStore *st)
+{
+    if (st == NULL) return;
+
+    /* NOLOAD section: contents are undefined after reset */
+    memset(st, 0, sizeof(*st));
+    st->base_seq = 1u;
+    st->next_seq = 1u;
+    st->time_seq = 1u;
+}
+
+void TrxStore_SetNextSeq(TrxStore *st, uint32_t seq)
+{
+    if (st == NULL || seq == 0u || st->next_seq != st->base_seq) return;
+    st->base_seq = seq;
+    st->next_seq = seq;
+    st->time_seq = seq;
+}
+
+uint32_t TrxStore_Count(const TrxStore *st)
+{
+    if (st == NULL) return 0u;
+    uint32_t n = st->next_seq - st->base_seq;
+    return (n > TRX_STORE_CAPACITY) ? TRX_STORE_CAPACITY : n;
+}
+
+uint32_t TrxStore_OldestSeq(const TrxStore *st)
+{
+    if (st == NULL) return 0u;
+    return st->next_seq - TrxStore_Count(st);
+}
+
+void TrxStore_OpenSale(TrxStore *st, uint8_t pump_id, uint8_t nozzle,
+                       uint32_t start_ms, bool tot_valid, uint32_t tot_before_cL)
+{
+    if (st == NULL || pump_id == 0u || pump_id > PUMP_MGR_MAX_PUMPS) return;
+
+    TrxStoreOpen *o = &st->open[pump_id - 1u];
+    o->open = true;
+    o->nozzle = nozzle;
+    o->start_ms = start_ms;
+    o->tot_valid = tot_valid;
+    o->tot_before_cL = tot_before_cL;
+}
+
+static void store_put(TrxStore *st, uint32_t seq, const TrxRecord *rec, uint32_t end_ms)
+{
+    TrxStoreOpen *o = &st->open[rec->pump_id - 1u];
+    TrxSale *s = &st->sale[seq % TRX_STORE_CAPACITY];
+
+    memset(s, 0, sizeof(*s));
+    s->seq = seq;
+    s->pump_id = rec->pump_id;
+    s->nozzle = o->open ? o->nozzle : 1u;
+    s->flags = rec->preset_money ? TRX_SALE_F_PRESET_MONEY : 0u;
+    s->recon = rec->recon;
+    s->volume_dL = rec->volume_dL;
+    s->money = rec->money;
+    s->preset = rec->preset;
+    s->price = rec->price;
+    s->start_ms = o->open ? o->start_ms : end_ms;
+    s->end_ms = end_ms;
+    if (o->open && o->tot_valid)
+    {
+        s->flags |= TRX_SALE_F_TOT_BEFORE;
+        s->tot_before_cL = o->tot_before_cL;
+    }
+    if (rec->tot_after_valid)
+    {
+        s->flags |= TRX_SALE_F_TOT_AFTER;
+        s->tot_after_cL = rec->tot_after_cL;
+    }
+    o->open = false;
+
+    if (store_indexed(rec->pump_id))
+    {
+        uint8_t p = (uint8_t)(rec->pump_id - 1u);
+        st->pump_seq[p][st->pump_next[p] % TRX_STORE_INDEX_DEPTH] = seq;
+        st->pump_next[p]++;
+    }
+}
+
+uint32_t TrxStore_CloseSale(TrxStore *st, const TrxRecord *rec, uint32_t end_ms)
+{
+    if (st == NULL || rec == NULL) return 0u;
+    if (rec->pump_id == 0u || rec->pump_id > PUMP_MGR_MAX_PUMPS) return 0u;
+
+    uint32_t seq = st->next_seq++;
+    store_put(st, seq, rec, end_ms);
+
+    /* Sales too old to compare with this one leave the time range */
+    uint32_t t = store_time_oldest(st);
+    while (t < seq)
+    {
+        const TrxSale *s = store_sale(st, t);
+        if (s->seq == t && (uint32_t)(end_ms - s->end_ms) <= TRX_STORE_TIME_SPAN_MS) break;
+        t++;
+    }
+    st->time_seq = t;
+    return seq;
+}
+
+bool TrxStore_Restore(TrxStore *st, const TrxRecord *rec)
+{
+    if (st == NULL || rec == NULL || rec->sale_id < st->next_seq) return false;
+    if (rec->pump_id == 0u || rec->pump_id > PUMP_MGR_MAX_PUMPS) return false;
+
+    /* Skipped numbers become holes; keep base_seq inside the ring */
+    if (st->next_seq == st->base_seq) st->base_seq = rec->sale_id;
+    st->next_seq = rec->sale_id + 1u;
+    if ((st->next_seq - st->base_seq) > TRX_STORE_CAPACITY) st->base_seq = st->next_seq - TRX_STORE_CAPACITY;
+
+    store_put(st, rec->sale_id, rec, 0u);
+    st->sale[rec->sale_id % TRX_STORE_CAPACITY].flags |= TRX_SALE_F_RESTORED;
+    st->time_seq = st->next_seq;
+    return true;
+}
+
+void TrxStore_SetTotalizerAfter(TrxStore *st, uint8_t pump_id, uint8_t nozzle, uint32_t tot_cL)
+{
+    if (st == NULL || TrxStore_Count(st) == 0u) return;
+    if (pump_id >= 1u && pump_id <= PUMP_MGR_MAX_PUMPS && st->open[pump_id - 1u].open) return;
+
+    /* Newest sale of the pump */
+    if (!store_indexed(pump_id)) return;
+    uint8_t p = (uint8_t)(pump_id - 1u);
+    if (st->pump_next[p] == 0u) return;
+    uint32_t seq = st->pump_seq[p][(st->pump_next[p] - 1u) % TRX_STORE_INDEX_DEPTH];
+    if (seq < TrxStore_OldestSeq(st)) return;
+
+    TrxSale *s = &st->sale[seq % TRX_STORE_CAPACITY];
+    if (s->nozzle != nozzle || (s->flags & TRX_SALE_F_TOT_AFTER)) return;
+
+    s->tot_after_cL = tot_cL;
+    s->flags |= TRX_SALE_F_TOT_AFTER;
+}
+
+bool TrxStore_Get(const TrxStore *st, uint32_t seq, TrxSale *out)
+{
+    if (st == NULL || out == NULL) return false;
+    if (seq == 0u || seq >= st->next_seq || seq < TrxStore_OldestSeq(st)) return false;
+
+    const TrxSale *s = store_sale(st, seq);
+    if (s->seq != seq) return false;
+
+    *out = *s;
+    return true;
+}
+
+void TrxStore_Seek(const TrxStore *st, TrxStoreCursor *c, uint8_t pump_id, uint8_t nozzle,
+                   uint32_t from_ms, uint32_t to_ms)
+{
+    if (st == NULL || c == NULL) return;
+
+    memset(c, 0, sizeof(*c));
+    c->pump_id = pump_id;
+    c->nozzle = nozzle;
+    c->from_ms = from_ms;
+    c->to_ms = to_ms;
+
+    uint32_t lo;
+    uint32_t hi;
+    if (store_indexed(pump_id))
+    {
+        uint32_t n = st->pump_next[pump_id - 1u];
+        lo = (n > TRX_STORE_INDEX_DEPTH) ? n - TRX_STORE_INDEX_DEPTH : 0u;
+        hi = n;
+    }
+    else
+    {
+        lo = store_time_oldest(st);
+        hi = st->next_seq;
+    }
+    c->end = hi;
+
+    /* First position that is live and ends at or after from_ms */
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        uint32_t seq = store_pos_seq(st, c, mid);
+        if (seq != 0u && store_time_ge(store_sale(st, seq)->end_ms, from_ms)) hi = mid;
+        else lo = mid + 1u;
+    }
+    c->pos = lo;
+}
+
+bool TrxStore_Next(const TrxStore *st, TrxStoreCursor *c, TrxSale *out)
+{
+    if (st == NULL || c == NULL) return false;
+
+    while (c->pos < c->end)
+    {
+        uint32_t seq = store_pos_seq(st, c, c->pos);
+        c->pos++;
+
+        /* Overwritten (or out of the time span) since the seek */
+        if (seq == 0u || seq < store_time_oldest(st)) continue;
+
+        const TrxSale *s = store_sale(st, seq);
+        if (s->seq != seq) continue;
+        if (!store_time_ge(c->to_ms, s->end_ms))
+        {
+            c->pos = c->end;
+            return false;
+        }
+        if (c->pump_id != 0u && s->pump_id != c->pump_id) continue;
+        if (c->nozzle != 0u && s->nozzle != c->nozzle) continue;
+
+        if (out != NULL) *out = *s;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,119 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    trx_upload.c
+  * @brief   Store-and-forward upload of finished sales to the host over CDC.
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#include "trx_upload.h"
+#include "cdc_logger.h"
+#include "crc32.h"
+#include <string.h>
+
+static void wr_u32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v & 0xFFu);
+    p[1] = (uint8_t)((v >> 8) & 0xFFu);
+    p[2] = (uint8_t)((v >> 16) & 0xFFu);
+    p[3] = (uint8_t)((v >> 24) & 0xFFu);
+}
+
+static void upload_pack(const TrxSale *s, uint8_t *p)
+{
+    memset(p, 0, TRX_UPLOAD_REC_SIZE);
+    wr_u32_le(&p[0], s->seq);
+    p[4] = s->pump_id;
+    p[5] = s->nozzle;
+    p[6] = s->flags;
+    p[7] = s->recon;
+    wr_u32_le(&p[8], s->volume_dL);
+    wr_u32_le(&p[12], s->money);
+    wr_u32_le(&p[16], s->preset);
+    wr_u32_le(&p[20], s->price);
+    wr_u32_le(&p[24], s->tot_before_cL);
+    wr_u32_le(&p[28], s->tot_after_cL);
+}
+
+void TrxUpload_Init(TrxUpload *u, TrxStore *store, TrxJournal *journal, uint32_t acked)
+{
+    if (u == NULL) return;
+    memset(u, 0, sizeof(*u));
+
+    u->store = store;
+    u->journal = journal;
+    u->acked = acked;
+    u->sent = acked;
+}
+
+bool TrxUpload_Request(TrxUpload *u, bool rewind)
+{
+    if (u == NULL || u->store == NULL) return false;
+    if (u->frame_len != 0u) return false;
+
+    if (rewind) u->sent = u->acked;
+
+    /* Sales evicted from the store before the host got them are skipped;
+       the seq gap tells the host */
+    uint32_t seq = u->sent + 1u;
+    uint32_t oldest = TrxStore_OldestSeq(u->store);
+    if (seq < oldest) seq = oldest;
+
+    uint8_t *f = u->frame;
+    uint8_t count = 0u;
+    TrxSale s;
+
+    for (; seq < u->store->next_seq && count < TRX_UPLOAD_BATCH; seq++)
+    {
+        if (!TrxStore_Get(u->store, seq, &s)) continue;     /* hole */
+        upload_pack(&s, &f[TRX_UPLOAD_HDR_SIZE + (uint16_t)count * TRX_UPLOAD_REC_SIZE]);
+        u->sent = seq;
+        count++;
+    }
+
+    f[0] = 0x55u;
+    f[1] = 0xAAu;
+    f[2] = (uint8_t)'U';
+    f[3] = count;
+    wr_u32_le(&f[4], u->acked);
+
+    uint16_t len = (uint16_t)(TRX_UPLOAD_HDR_SIZE + (uint16_t)count * TRX_UPLOAD_REC_SIZE);
+    wr_u32_le(&f[len], CRC32_Calc(&f[2], (uint32_t)len - 2u));
+    u->frame_len = (uint16_t)(len + 4u);
+    return true;
+}
+
+bool TrxUpload_Ack(TrxUpload *u, uint32_t seq)
+{
+    if (u == NULL || seq > u->sent || seq < u->acked) return false;
+    if (seq == u->acked) return true;
+
+    u->acked = seq;
+
+    TrxRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = TRX_REC_UPLOAD_ACK;
+    rec.sale_id = seq;
+    TrxJournal_Append(u->journal, &rec);
+    return true;
+}
+
+uint32_t TrxUpload_Backlog(const TrxUpload *u)
+{
+    if (u == NULL || u->store == NULL) return 0u;
+
+    uint32_t from = u->acked + 1u;
+    uint32_t oldest = TrxStore_OldestSeq(u->store);
+    if (from < oldest) from = oldest;
+    return (u->store->next_seq > from) ? u->store->next_seq - from : 0u;
+}
+
+void TrxUpload_Task(TrxUpload *u)
+{
+    if (u == NULL || u->frame_len == 0u) return;
+    if (CDC_LOG_GetFree() < u->frame_len) return;
+
+    CDC_LOG_PushBytes(u->frame, u->frame_len);
+    u->frame_len = 0u;
+}
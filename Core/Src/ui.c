@@ -2,6 +2,7 @@
 #include "ui.h"
 #include "ssd1309.h"
 #include "pump_transactions.h"
+#include "fixed_dec.h"
 #include "stm32h7xx_hal.h"
 #include <stdio.h>
 #include <string.h>
@@ -14,6 +15,16 @@
 #define KEY_ESC   ('F')
 #define KEY_OK    ('K')
 
+/* Refresh period while a sale runs (realtime values move) / when all idle */
+#define UI_RENDER_ACTIVE_MS   (100u)
+#define UI_RENDER_IDLE_MS     (1000u)
+
+/* Full tank = a volume preset worth this much money at the current price */
+#define UI_FULL_TANK_MONEY    (999999u)
+
+/* Totalizer list rows per page (rows 1..6, header and key hint around them) */
+#define UI_TOT_ROWS           (6u)
+
 static void ui_clear(void) { SSD1309_Fill(0); }
 
 static void ui_line(uint8_t row, const char *text)
@@ -31,7 +42,15 @@ static void format_volume(uint32_t volume_dL, char *buf, size_t len)
 
 static TransactionFSM* ui_get_fsm(UI_Context *ui)
 {
-    return (ui->active_pump_id == 1) ? ui->trk1_fsm : ui->trk2_fsm;
+    if (ui->active_idx >= ui->fsm_count) return NULL;
+    return ui->fsm[ui->active_idx];
+}
+
+static void ui_select(UI_Context *ui, uint8_t idx)
+{
+    if (idx >= ui->fsm_count) return;
+    ui->active_idx = idx;
+    ui->active_pump_id = ui->fsm[idx]->pump_id;
 }
 
 /* ========== HOME SCREEN ========== */
@@ -42,11 +61,14 @@ static void ui_render_home(UI_Context *ui)
     char line[17];
     uint8_t row = 0;
     
-    for (uint8_t i = 0; i < 2; i++) {
-        TransactionFSM *fsm = (i == 0) ? ui->trk1_fsm : ui->trk2_fsm;
+    /* Scroll so the selected pump stays on screen (8 rows) */
+    uint8_t first = (ui->active_idx > 3) ? (uint8_t)(ui->active_idx - 3) : 0;
+    
+    for (uint8_t i = first; i < ui->fsm_count && row < 8; i++) {
+        TransactionFSM *fsm = ui->fsm[i];
         if (!fsm) continue;
         
-        uint8_t trk_id = i + 1;
+        uint8_t trk_id = fsm->pump_id;
         char sel = (ui->active_pump_id == trk_id) ? '>' : ' ';
         char pause = ' ';
         char active = ' ';
@@ -64,18 +86,20 @@ static void ui_render_home(UI_Context *ui)
         }
         
         if (state != TRX_IDLE) {
-            const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, trk_id);
-            uint16_t price = dev ? dev->price : 0;
+            PumpSnapshot dev;
+            unsigned long price = PumpMgr_Snapshot(fsm->mgr, trk_id, &dev) ? (unsigned long)dev.price : 0u;
             
-            snprintf(line, sizeof(line), "%c%c%cTRK%u: P%04u", sel, pause, active, trk_id, price);
+            /* '+' = preset for the next customer already queued */
+            char next = TrxFSM_GetQueuedPreset(fsm, NULL, NULL) ? '+' : ' ';
+            snprintf(line, sizeof(line), "%c%c%cTRK%u: P%04lu%c", sel, pause, active, trk_id, price, next);
             ui_line(row++, line);
             
             char vol_str[12];
-            format_volume(TrxFSM_GetRealtimeVolume(fsm), vol_str, sizeof(vol_str));
+            format_volume(TrxFSM_GetDisplayVolume(fsm), vol_str, sizeof(vol_str));
             snprintf(line, sizeof(line), "  L: %s", vol_str);
             ui_line(row++, line);
             
-            snprintf(line, sizeof(line), "  P: %06lu", (unsigned long)TrxFSM_GetRealtimeMoney(fsm));
+            snprintf(line, sizeof(line), "  P: %06lu", (unsigned long)TrxFSM_GetDisplayMoney(fsm));
             ui_line(row++, line);
         } else {
             snprintf(line, sizeof(line), "%cTRK%u", sel, trk_id);
@@ -89,11 +113,11 @@ static void ui_render_home(UI_Context *ui)
 static bool ui_handle_home(UI_Context *ui, char key)
 {
     if (key == KEY_TIM) {
-        ui->active_pump_id = 1;
+        if (ui->active_idx > 0) ui_select(ui, (uint8_t)(ui->active_idx - 1));
         return true;
     }
     else if (key == KEY_SEL) {
-        ui->active_pump_id = 2;
+        ui_select(ui, (uint8_t)(ui->active_idx + 1));
         return true;
     }
     else if (key == KEY_PRI) {
@@ -103,21 +127,11 @@ static bool ui_handle_home(UI_Context *ui, char key)
     }
     else if (key == KEY_TOT) {
         ui->screen = UI_SCREEN_TOTALIZER;
+        ui->tot_page = 0;
         
-        /* Request totalizers */
-        if (ui->trk1_fsm && ui->trk1_fsm->gkl) {
-            GKL_Link *gkl = &ui->trk1_fsm->gkl->link;
-            const PumpDevice *dev = PumpMgr_GetConst(ui->trk1_fsm->mgr, 1);
-            if (dev && gkl->state == GKL_STATE_IDLE) {
-                PumpTrans_ReadTotalizer(gkl, dev->ctrl_addr, dev->slave_addr, 0);
-            }
-        }
-        if (ui->trk2_fsm && ui->trk2_fsm->gkl) {
-            GKL_Link *gkl = &ui->trk2_fsm->gkl->link;
-            const PumpDevice *dev = PumpMgr_GetConst(ui->trk2_fsm->mgr, 2);
-            if (dev && gkl->state == GKL_STATE_IDLE) {
-                PumpTrans_ReadTotalizer(gkl, dev->ctrl_addr, dev->slave_addr, 0);
-            }
+        /* Screen reads the PumpMgr cache; just ask for fresh values */
+        if (ui->fsm_count > 0 && ui->fsm[0]->mgr) {
+            PumpMgr_RefreshTotalizers(ui->fsm[0]->mgr, 0);
         }
         return true;
     }
@@ -182,9 +196,11 @@ static bool ui_handle_select_mode(UI_Context *ui, char key)
             /* Full tank */
             TransactionFSM *fsm = ui_get_fsm(ui);
             if (fsm) {
-                const PumpDevice *dev = PumpMgr_GetConst(fsm->mgr, fsm->pump_id);
-                if (dev) {
-                    uint32_t max_volume_dL = (999999UL * 10UL) / dev->price;
+                PumpSnapshot dev;
+                uint32_t max_volume_dL;
+                /* No price yet (0): nothing to size the preset by */
+                if (PumpMgr_Snapshot(fsm->mgr, fsm->pump_id, &dev) &&
+                    FixDec_DLOfMoney(UI_FULL_TANK_MONEY, dev.price, FIXDEC_ROUND_DOWN, &max_volume_dL)) {
                     TrxFSM_StartVolume(fsm, max_volume_dL);
                 }
             }
@@ -253,26 +269,9 @@ static bool ui_handle_preset_volume(UI_Context *ui, char key)
     else if (key == KEY_OK) {
         if (ui->edit_len > 0) {
             /* Parse: "25.5" → 255 dL */
-            uint32_t int_part = 0, frac_part = 0;
-            bool after_dot = false;
-            uint8_t frac_digits = 0;
-            
-            for (uint8_t i = 0; i < ui->edit_len; i++) {
-                if (ui->edit_buf[i] == '.') {
-                    after_dot = true;
-                } else if (!after_dot) {
-                    int_part = int_part * 10 + (ui->edit_buf[i] - '0');
-                } else {
-                    frac_part = frac_part * 10 + (ui->edit_buf[i] - '0');
-                    frac_digits++;
-                }
-            }
-            
-            if (frac_digits > 1) frac_part /= 10;
-            uint32_t volume_dL = int_part * 10 + frac_part;
-            
+            uint32_t volume_dL;
             TransactionFSM *fsm = ui_get_fsm(ui);
-            if (fsm) {
+            if (fsm && FixDec_ParseDL(ui->edit_buf, ui->edit_len, &volume_dL)) {
                 TrxFSM_StartVolume(fsm, volume_dL);
             }
             
@@ -349,30 +348,72 @@ static bool ui_handle_preset_money(UI_Context *ui, char key)
 }
 
 /* ========== TOTALIZER ========== */
+/* One row per pump and nozzle */
+static uint16_t ui_tot_count(UI_Context *ui)
+{
+    uint16_t n = 0;
+    for (uint8_t i = 0; i < ui->fsm_count; i++) {
+        if (ui->fsm[i]) n += PumpMgr_GetNozzleCount(ui->fsm[i]->mgr, ui->fsm[i]->pump_id);
+    }
+    return n;
+}
+
+static uint8_t ui_tot_pages(UI_Context *ui)
+{
+    uint16_t pages = (uint16_t)((ui_tot_count(ui) + UI_TOT_ROWS - 1u) / UI_TOT_ROWS);
+    if (pages == 0) pages = 1;
+    return (pages > 255u) ? 255u : (uint8_t)pages;
+}
+
 static void ui_render_totalizer(UI_Context *ui)
 {
     ui_clear();
     
-    ui_line(0, "TOTALIZERS");
-    ui_line(1, "");
+    char line[17];
+    uint8_t pages = ui_tot_pages(ui);
+    if (ui->tot_page >= pages) ui->tot_page = (uint8_t)(pages - 1u);
+    snprintf(line, sizeof(line), "TOTALIZERS %u/%u", (unsigned)(ui->tot_page + 1u), (unsigned)pages);
+    ui_line(0, line);
     
-    for (uint8_t i = 0; i < 2; i++) {
-        TransactionFSM *fsm = (i == 0) ? ui->trk1_fsm : ui->trk2_fsm;
+    uint16_t first = (uint16_t)(ui->tot_page * UI_TOT_ROWS);
+    uint16_t pos = 0;
+    uint8_t row = 1;
+    
+    for (uint8_t i = 0; i < ui->fsm_count && row <= UI_TOT_ROWS; i++) {
+        TransactionFSM *fsm = ui->fsm[i];
         if (!fsm) continue;
         
-        char line[17], vol_str[12];
-        format_volume(fsm->totalizer_dL, vol_str, sizeof(vol_str));
-        snprintf(line, sizeof(line), "TRK%u: %s", i+1, vol_str);
-        ui_line(2 + i * 2, line);
+        uint8_t nozzles = PumpMgr_GetNozzleCount(fsm->mgr, fsm->pump_id);
+        for (uint8_t n = 1; n <= nozzles && row <= UI_TOT_ROWS; n++, pos++) {
+            if (pos < first) continue;
+            
+            char vol_str[12];
+            PumpTotalizer tot;
+            if (PumpMgr_GetTotalizer(fsm->mgr, fsm->pump_id, n, &tot) && tot.valid) {
+                format_volume(FixDec_CLToDL(tot.value, FIXDEC_ROUND_DOWN), vol_str, sizeof(vol_str));
+            } else {
+                snprintf(vol_str, sizeof(vol_str), "---.-");
+            }
+            snprintf(line, sizeof(line), "TRK%u/%u %s", fsm->pump_id, n, vol_str);
+            ui_line(row++, line);
+        }
     }
     
-    ui_line(7, "ESC:back");
+    ui_line(7, pages > 1 ? "TIM/SEL:page ESC" : "ESC:back");
     SSD1309_UpdateScreen();
 }
 
 static bool ui_handle_totalizer(UI_Context *ui, char key)
 {
-    if (key == KEY_ESC || key == KEY_OK) {
+    if (key == KEY_TIM) {
+        if (ui->tot_page > 0) ui->tot_page--;
+        return true;
+    }
+    else if (key == KEY_SEL) {
+        if ((uint8_t)(ui->tot_page + 1u) < ui_tot_pages(ui)) ui->tot_page++;
+        return true;
+    }
+    else if (key == KEY_ESC || key == KEY_OK) {
         ui->screen = UI_SCREEN_HOME;
         return true;
     }
@@ -380,18 +421,42 @@ static bool ui_handle_totalizer(UI_Context *ui, char key)
 }
 
 /* ========== INIT & TASK ========== */
-void UI_Init(UI_Context *ui, TransactionFSM *trk1_fsm, TransactionFSM *trk2_fsm, Settings *settings)
+static void ui_on_pump_change(void *ctx, const PumpMgrNotify *n)
 {
-    if (!ui) return;
+    UI_Context *ui = (UI_Context *)ctx;
+    (void)n;
+    if (ui) ui->dirty = true;
+}
+
+static bool ui_any_active(UI_Context *ui)
+{
+    for (uint8_t i = 0; i < ui->fsm_count; i++) {
+        if (ui->fsm[i] && TrxFSM_GetState(ui->fsm[i]) != TRX_IDLE) return true;
+    }
+    return false;
+}
+
+bool UI_Init(UI_Context *ui, TransactionFSM *const *fsm, uint8_t fsm_count, Settings *settings)
+{
+    if (!ui) return false;
     
     memset(ui, 0, sizeof(*ui));
-    ui->trk1_fsm = trk1_fsm;
-    ui->trk2_fsm = trk2_fsm;
+    ui->fsm = fsm;
+    ui->fsm_count = (fsm != NULL) ? fsm_count : 0;
     ui->settings = settings;
     ui->screen = UI_SCREEN_HOME;
-    ui->active_pump_id = 1;
+    ui_select(ui, 0);
     ui->selected_mode = 0;
     ui->blink_timer_ms = HAL_GetTick();
+    ui->dirty = true;
+    
+    /* Redraw on pump changes instead of fixed-rate polling */
+    if (ui->fsm_count > 0 && fsm[0]->mgr) {
+        return PumpMgr_Subscribe(fsm[0]->mgr, 0,
+                                 PUMP_MGR_NOTIFY_STATUS | PUMP_MGR_NOTIFY_PRICE | PUMP_MGR_NOTIFY_TOTALIZER,
+                                 ui_on_pump_change, ui) != 0;
+    }
+    return true;
 }
 
 void UI_Task(UI_Context *ui, char key)
@@ -427,9 +492,11 @@ void UI_Task(UI_Context *ui, char key)
         }
     }
     
-    /* Periodic render */
-    if (need_render || (now - ui->last_render_ms) >= 100) {
+    /* Render on input or pump change; periodic refresh only matters while a sale runs */
+    uint32_t period = ui_any_active(ui) ? UI_RENDER_ACTIVE_MS : UI_RENDER_IDLE_MS;
+    if (need_render || ui->dirty || (now - ui->last_render_ms) >= period) {
         ui->last_render_ms = now;
+        ui->dirty = false;
         
         if (ui->screen == UI_SCREEN_HOME) {
             ui_render_home(ui);
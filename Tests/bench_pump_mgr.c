@@ -0,0 +1,99 @@
+/* bench_pump_mgr.c - Cost of one PumpMgr_Task pass with 32 and 255 pumps.
+   Fake links answer every status poll at once with "idle", so each pass
+   runs the event path, the due-time scan and one poll per link. Built twice,
+   once per PUMP_MGR_MAX_PUMPS (see Makefile). */
+#include "host_stub.h"
+#include "pump_mgr.h"
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_PASSES
+#define BENCH_PASSES  (200000u)
+#endif
+
+/* ===== Fake link: one reply queued per poll ===== */
+
+typedef struct {
+    bool     pending;
+    PumpEvent ev;
+    uint32_t polls;
+} FakeLink;
+
+static bool fake_idle(void *ctx) { return !((FakeLink *)ctx)->pending; }
+
+static PumpProtoResult fake_poll(void *ctx, uint8_t ctrl, uint8_t slave)
+{
+    FakeLink *l = (FakeLink *)ctx;
+    memset(&l->ev, 0, sizeof(l->ev));
+    l->ev.type = PUMP_EVT_STATUS;
+    l->ev.ctrl_addr = ctrl;
+    l->ev.slave_addr = slave;
+    l->ev.status = 1u;
+    l->ev.nozzle = 1u;
+    l->pending = true;
+    l->polls++;
+    return PUMP_PROTO_OK;
+}
+
+static bool fake_pop(void *ctx, PumpEvent *out)
+{
+    FakeLink *l = (FakeLink *)ctx;
+    if (!l->pending) return false;
+    *out = l->ev;
+    l->pending = false;
+    return true;
+}
+
+static const PumpProtoVTable g_fake_vt = {
+    .is_idle = fake_idle,
+    .send_poll_status = fake_poll,
+    .pop_event = fake_pop,
+};
+
+/* ===== Bench ===== */
+
+static PumpMgr g_mgr;
+static FakeLink g_link[PUMP_MGR_MAX_LINKS];
+static PumpProto g_proto[PUMP_MGR_MAX_LINKS];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int main(void)
+{
+    g_host_tick = 1u;
+    PumpMgr_Init(&g_mgr, 500u);
+
+    /* Pumps spread evenly over the links, slave addresses 1..32 */
+    for (uint16_t k = 0u; k < PUMP_MGR_MAX_PUMPS; k++)
+    {
+        uint8_t link = (uint8_t)(k % PUMP_MGR_MAX_LINKS);
+        g_proto[link].vt = &g_fake_vt;
+        g_proto[link].ctx = &g_link[link];
+        CHECK(PumpMgr_Add(&g_mgr, (uint8_t)(k + 1u), &g_proto[link], 0x00u,
+                          (uint8_t)(k / PUMP_MGR_MAX_LINKS + 1u)));
+    }
+    CHECK_EQ(g_mgr.count, PUMP_MGR_MAX_PUMPS);
+
+    /* Warm-up: every pump polled once */
+    for (uint32_t n = 0u; n < 2000u; n++, g_host_tick++) PumpMgr_Task(&g_mgr);
+
+    uint32_t polls = 0u;
+    for (uint8_t l = 0u; l < PUMP_MGR_MAX_LINKS; l++) polls += g_link[l].polls;
+
+    double t0 = now_ns();
+    for (uint32_t n = 0u; n < BENCH_PASSES; n++, g_host_tick++) PumpMgr_Task(&g_mgr);
+    double t1 = now_ns();
+
+    uint32_t polls_after = 0u;
+    for (uint8_t l = 0u; l < PUMP_MGR_MAX_LINKS; l++) polls_after += g_link[l].polls;
+
+    printf("bench_pump_mgr: %3u pumps, %u links: %7.1f ns/pass, %u polls, PumpMgr %zu B\n",
+           (unsigned)PUMP_MGR_MAX_PUMPS, (unsigned)PUMP_MGR_MAX_LINKS,
+           (t1 - t0) / (double)BENCH_PASSES, (unsigned)(polls_after - polls), sizeof(PumpMgr));
+    return host_report("bench_pump_mgr");
+}
@@ -0,0 +1,25 @@
+/* host_stub.c - Fake clock, log sink and check counters for host tests */
+#include "host_stub.h"
+#include "stm32h7xx_hal.h"
+#include "cdc_logger.h"
+#include <stdlib.h>
+
+uint32_t g_host_tick = 0;
+unsigned g_host_fail = 0;
+unsigned g_host_checks = 0;
+
+uint32_t HAL_GetTick(void)
+{
+    return g_host_tick;
+}
+
+void CDC_Log(const char *msg)
+{
+    if (getenv("HOST_VERBOSE") != NULL) printf("  log: %s\n", msg);
+}
+
+int host_report(const char *name)
+{
+    printf("%s: %u checks, %u failed\n", name, g_host_checks, g_host_fail);
+    return g_host_fail ? 1 : 0;
+}
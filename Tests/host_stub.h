@@ -0,0 +1,26 @@
+/* host_stub.h - Fake clock, log sink and check macros for host tests */
+#ifndef HOST_STUB_H
+#define HOST_STUB_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern uint32_t g_host_tick;
+extern unsigned g_host_fail;
+extern unsigned g_host_checks;
+
+#define CHECK(cond) do { \
+    g_host_checks++; \
+    if (!(cond)) { g_host_fail++; printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    unsigned long long _a = (unsigned long long)(a), _b = (unsigned long long)(b); \
+    g_host_checks++; \
+    if (_a != _b) { g_host_fail++; printf("%s:%d: %s == %llu, expected %llu\n", __FILE__, __LINE__, #a, _a, _b); } \
+} while (0)
+
+/* Summary line, process exit code */
+int host_report(const char *name);
+
+#endif
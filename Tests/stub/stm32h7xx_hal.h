@@ -0,0 +1,16 @@
+/* stm32h7xx_hal.h - host stand-in: just what the tested modules use */
+#ifndef STM32H7XX_HAL_H
+#define STM32H7XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef struct { uint32_t ErrorCode; } UART_HandleTypeDef;
+
+#define __DMB()  __sync_synchronize()
+
+/* Driven by the test (see host_stub.c) */
+uint32_t HAL_GetTick(void);
+
+#endif
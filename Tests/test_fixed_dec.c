@@ -0,0 +1,169 @@
+/* test_fixed_dec.c - Fixed-point helpers on the host: rounding modes, BCD8
+   limits, overflow and division by zero, volume parsing. */
+#include "host_stub.h"
+#include "fixed_dec.h"
+#include <string.h>
+
+static uint32_t muldiv(uint32_t a, uint32_t b, uint32_t d, FixDecRound r)
+{
+    uint32_t out = 0xDEADBEEFu;
+    CHECK(FixDec_MulDiv(a, b, d, r, &out));
+    return out;
+}
+
+static bool parse(const char *s, uint32_t *dL)
+{
+    return FixDec_ParseDL(s, (uint8_t)strlen(s), dL);
+}
+
+/* ===== Cases ===== */
+
+static void test_rounding(void)
+{
+    /* 25 / 10 = 2.5: a tie */
+    CHECK_EQ(muldiv(25u, 1u, 10u, FIXDEC_ROUND_DOWN), 2u);
+    CHECK_EQ(muldiv(25u, 1u, 10u, FIXDEC_ROUND_UP), 3u);
+    CHECK_EQ(muldiv(25u, 1u, 10u, FIXDEC_ROUND_HALF_UP), 3u);
+    CHECK_EQ(muldiv(25u, 1u, 10u, FIXDEC_ROUND_HALF_EVEN), 2u);
+    CHECK_EQ(muldiv(35u, 1u, 10u, FIXDEC_ROUND_HALF_EVEN), 4u);
+
+    /* 24 / 10 and 26 / 10: off the tie */
+    CHECK_EQ(muldiv(24u, 1u, 10u, FIXDEC_ROUND_UP), 3u);
+    CHECK_EQ(muldiv(24u, 1u, 10u, FIXDEC_ROUND_HALF_UP), 2u);
+    CHECK_EQ(muldiv(24u, 1u, 10u, FIXDEC_ROUND_HALF_EVEN), 2u);
+    CHECK_EQ(muldiv(26u, 1u, 10u, FIXDEC_ROUND_DOWN), 2u);
+    CHECK_EQ(muldiv(26u, 1u, 10u, FIXDEC_ROUND_HALF_UP), 3u);
+    CHECK_EQ(muldiv(26u, 1u, 10u, FIXDEC_ROUND_HALF_EVEN), 3u);
+
+    /* Exact quotients are never moved */
+    CHECK_EQ(muldiv(30u, 1u, 10u, FIXDEC_ROUND_UP), 3u);
+    CHECK_EQ(muldiv(0u, 7u, 3u, FIXDEC_ROUND_UP), 0u);
+
+    /* Odd divisor: 2 * rem never equals d */
+    CHECK_EQ(muldiv(5u, 1u, 3u, FIXDEC_ROUND_HALF_EVEN), 2u);
+    CHECK_EQ(muldiv(4u, 1u, 3u, FIXDEC_ROUND_HALF_UP), 1u);
+
+    /* Largest divisor: 2 * rem needs 33 bits */
+    CHECK_EQ(muldiv(UINT32_MAX, 1u, UINT32_MAX, FIXDEC_ROUND_HALF_UP), 1u);
+    CHECK_EQ(muldiv(UINT32_MAX - 1u, 1u, UINT32_MAX, FIXDEC_ROUND_HALF_UP), 1u);
+    CHECK_EQ(muldiv(0x7FFFFFFFu, 1u, UINT32_MAX, FIXDEC_ROUND_HALF_UP), 0u);
+    CHECK_EQ(muldiv(0x80000000u, 1u, UINT32_MAX, FIXDEC_ROUND_HALF_UP), 1u);
+}
+
+static void test_overflow(void)
+{
+    uint32_t out = 1234u;
+
+    /* Product above 32 bits but quotient fits */
+    CHECK_EQ(muldiv(UINT32_MAX, UINT32_MAX, UINT32_MAX, FIXDEC_ROUND_DOWN), UINT32_MAX);
+
+    /* Quotient above 32 bits: false, output untouched */
+    CHECK(!FixDec_MulDiv(UINT32_MAX, 2u, 1u, FIXDEC_ROUND_DOWN, &out));
+    CHECK_EQ(out, 1234u);
+    /* Rounding up past UINT32_MAX */
+    CHECK(!FixDec_MulDiv(UINT32_MAX, 3u, 2u, FIXDEC_ROUND_UP, &out));
+    CHECK(!FixDec_MulDiv(1u, 1u, 0u, FIXDEC_ROUND_DOWN, &out));
+    CHECK(!FixDec_MulDiv(1u, 1u, 1u, FIXDEC_ROUND_DOWN, NULL));
+    CHECK_EQ(out, 1234u);
+
+    CHECK(FixDec_Add(UINT32_MAX - 1u, 1u, &out));
+    CHECK_EQ(out, UINT32_MAX);
+    CHECK(!FixDec_Add(UINT32_MAX, 1u, &out));
+    CHECK_EQ(out, UINT32_MAX);
+
+    CHECK(FixDec_DLToCL(UINT32_MAX / 10u, &out));
+    CHECK_EQ(out, (UINT32_MAX / 10u) * 10u);
+    CHECK(!FixDec_DLToCL(UINT32_MAX / 10u + 1u, &out));
+}
+
+static void test_units(void)
+{
+    uint32_t out = 0u;
+
+    CHECK_EQ(FixDec_CLToDL(1234u, FIXDEC_ROUND_DOWN), 123u);
+    CHECK_EQ(FixDec_CLToDL(1235u, FIXDEC_ROUND_HALF_UP), 124u);
+    CHECK_EQ(FixDec_CLToDL(1235u, FIXDEC_ROUND_HALF_EVEN), 124u);
+    CHECK_EQ(FixDec_CLToDL(1225u, FIXDEC_ROUND_HALF_EVEN), 122u);
+    CHECK_EQ(FixDec_CLToDL(UINT32_MAX, FIXDEC_ROUND_UP), UINT32_MAX / 10u + 1u);
+
+    /* 12.5 L at 259 per litre = 3237.5 */
+    CHECK(FixDec_MoneyOfDL(125u, 259u, FIXDEC_ROUND_HALF_UP, &out));
+    CHECK_EQ(out, 3238u);
+    CHECK(FixDec_MoneyOfDL(125u, 259u, FIXDEC_ROUND_DOWN, &out));
+    CHECK_EQ(out, 3237u);
+    CHECK(FixDec_MoneyOfMDL(125500u, 259u, FIXDEC_ROUND_HALF_UP, &out));
+    CHECK_EQ(out, 3250u);
+
+    /* 5000 at 259 per litre = 193.05 dL, a preset limit rounds down */
+    CHECK(FixDec_DLOfMoney(5000u, 259u, FIXDEC_ROUND_DOWN, &out));
+    CHECK_EQ(out, 193u);
+    out = 77u;
+    CHECK(!FixDec_DLOfMoney(5000u, 0u, FIXDEC_ROUND_DOWN, &out));
+    CHECK_EQ(out, 77u);
+}
+
+static void test_bcd8(void)
+{
+    uint32_t out = 0u;
+
+    /* Largest preset the GKL fields take, both ways */
+    CHECK(FixDec_DLToCL(FIXDEC_BCD8_MAX / 10u, &out));
+    CHECK(out <= FIXDEC_BCD8_MAX);
+    CHECK(FixDec_DLToCL(FIXDEC_BCD8_MAX / 10u + 1u, &out));
+    CHECK(out > FIXDEC_BCD8_MAX);
+
+    /* Money for a full BCD8 volume at the highest host price: above 32 bits */
+    out = 5u;
+    CHECK(!FixDec_MoneyOfDL(FIXDEC_BCD8_MAX, 9999u, FIXDEC_ROUND_HALF_UP, &out));
+    CHECK_EQ(out, 5u);
+    CHECK(FixDec_MoneyOfDL(FIXDEC_BCD8_MAX, 429u, FIXDEC_ROUND_HALF_UP, &out));
+    CHECK(out > FIXDEC_BCD8_MAX);
+    CHECK(FixDec_DLOfMoney(FIXDEC_BCD8_MAX, 1u, FIXDEC_ROUND_DOWN, &out));
+    CHECK_EQ(out, FIXDEC_BCD8_MAX * 10u);
+}
+
+static void test_parse(void)
+{
+    uint32_t dL = 0u;
+
+    CHECK(parse("25.5", &dL));
+    CHECK_EQ(dL, 255u);
+    CHECK(parse("25", &dL));
+    CHECK_EQ(dL, 250u);
+    CHECK(parse("25.", &dL));
+    CHECK_EQ(dL, 250u);
+    CHECK(parse(".5", &dL));
+    CHECK_EQ(dL, 5u);
+    CHECK(parse("0", &dL));
+    CHECK_EQ(dL, 0u);
+    /* Further fraction digits rounded down */
+    CHECK(parse("1.99", &dL));
+    CHECK_EQ(dL, 19u);
+
+    /* No digits, bad characters, a second dot */
+    dL = 42u;
+    CHECK(!parse("", &dL));
+    CHECK(!parse(".", &dL));
+    CHECK(!parse("1a", &dL));
+    CHECK(!parse("1.2.3", &dL));
+    CHECK(!parse("-1", &dL));
+    CHECK_EQ(dL, 42u);
+
+    /* Overflow in the litres and in the dL conversion */
+    CHECK(parse("429496729.5", &dL));
+    CHECK_EQ(dL, 4294967295u);
+    CHECK(!parse("429496729.6", &dL));
+    CHECK(!parse("429496730", &dL));
+    CHECK(!parse("99999999999", &dL));
+    CHECK_EQ(dL, 4294967295u);
+}
+
+int main(void)
+{
+    test_rounding();
+    test_overflow();
+    test_units();
+    test_bcd8();
+    test_parse();
+    return host_report("test_fixed_dec");
+}
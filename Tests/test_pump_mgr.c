@@ -0,0 +1,72 @@
+/* test_pump_mgr.c - Pump manager topology on the host: duplicate ids and
+   addresses are rejected without using up a bus, links are capped. */
+#include "host_stub.h"
+#include "pump_mgr.h"
+#include <string.h>
+
+static PumpMgr g_mgr;
+static const PumpProtoVTable g_vt;
+static int g_ctx[PUMP_MGR_MAX_LINKS + 1u];
+static PumpProto g_proto[PUMP_MGR_MAX_LINKS + 1u];
+
+static void setup(void)
+{
+    g_host_tick = 1000u;
+    PumpMgr_Init(&g_mgr, 500u);
+    for (uint8_t l = 0u; l <= PUMP_MGR_MAX_LINKS; l++)
+    {
+        g_proto[l].vt = &g_vt;
+        g_proto[l].ctx = &g_ctx[l];
+    }
+}
+
+/* ===== Cases ===== */
+
+static void test_duplicates(void)
+{
+    setup();
+    CHECK(PumpMgr_Add(&g_mgr, 1u, &g_proto[0], 0x00u, 1u));
+    CHECK(PumpMgr_Add(&g_mgr, 2u, &g_proto[0], 0x00u, 2u));
+    CHECK_EQ(g_mgr.bus_count, 1u);
+
+    /* Same id on another link: rejected, no bus created for it */
+    CHECK(!PumpMgr_Add(&g_mgr, 1u, &g_proto[1], 0x00u, 1u));
+    CHECK_EQ(g_mgr.bus_count, 1u);
+
+    /* Same slave address on the same link */
+    CHECK(!PumpMgr_Add(&g_mgr, 3u, &g_proto[0], 0x00u, 2u));
+    CHECK_EQ(g_mgr.count, 2u);
+
+    /* Out-of-range slave address */
+    CHECK(!PumpMgr_Add(&g_mgr, 3u, &g_proto[1], 0x00u, PUMP_MGR_MAX_SLAVE_ADDR + 1u));
+    CHECK_EQ(g_mgr.bus_count, 1u);
+
+    /* The same address on another link is a different pump */
+    CHECK(PumpMgr_Add(&g_mgr, 3u, &g_proto[1], 0x00u, 2u));
+    CHECK_EQ(g_mgr.bus_count, 2u);
+    CHECK_EQ(PumpMgr_GetSlaveAddr(&g_mgr, 3u), 2u);
+}
+
+static void test_links(void)
+{
+    setup();
+    for (uint8_t l = 0u; l < PUMP_MGR_MAX_LINKS; l++)
+    {
+        CHECK(PumpMgr_Add(&g_mgr, (uint8_t)(l + 1u), &g_proto[l], 0x00u, 1u));
+    }
+    CHECK_EQ(g_mgr.bus_count, PUMP_MGR_MAX_LINKS);
+
+    /* One link too many */
+    CHECK(!PumpMgr_Add(&g_mgr, 100u, &g_proto[PUMP_MGR_MAX_LINKS], 0x00u, 1u));
+    CHECK_EQ(g_mgr.count, PUMP_MGR_MAX_LINKS);
+
+    /* Existing links still take pumps */
+    CHECK(PumpMgr_Add(&g_mgr, 100u, &g_proto[0], 0x00u, 2u));
+}
+
+int main(void)
+{
+    test_duplicates();
+    test_links();
+    return host_report("test_pump_mgr");
+}
@@ -0,0 +1,506 @@
+/* test_transaction_fsm.c - Transition table on the host: guards, sale path,
+   stale S9, preset and armed timeouts, cancel, missed-status and pause rows. The real pump manager supplies
+   snapshots; the frame senders are recorded instead of going on the wire. */
+#include "host_stub.h"
+#include "transaction_fsm.h"
+#include "pump_transactions.h"
+#include <string.h>
+
+/* ===== Frame senders (recorded) ===== */
+
+static char g_sent[32];
+static uint8_t g_sent_len = 0;
+static bool g_link_busy = false;
+
+static bool sent(char cmd)
+{
+    if (g_link_busy) return false;
+    if (g_sent_len < sizeof(g_sent) - 1u) g_sent[g_sent_len++] = cmd;
+    return true;
+}
+
+static char last_sent(void)
+{
+    return g_sent_len ? g_sent[g_sent_len - 1u] : '\0';
+}
+
+bool PumpTrans_PresetVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle,
+                            uint32_t volume_dL, uint32_t price, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)nozzle; (void)volume_dL; (void)price; (void)done; return sent('V'); }
+bool PumpTrans_PresetMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle,
+                           uint32_t money, uint32_t price, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)nozzle; (void)money; (void)price; (void)done; return sent('M'); }
+bool PumpTrans_Stop(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)done; return sent('B'); }
+bool PumpTrans_Resume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)done; return sent('G'); }
+bool PumpTrans_End(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)done; return sent('N'); }
+bool PumpTrans_PollRealtimeVolume(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)nozzle; (void)done; return sent('L'); }
+bool PumpTrans_PollRealtimeMoney(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)nozzle; (void)done; return sent('R'); }
+bool PumpTrans_ReadTotalizer(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, uint8_t nozzle, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)nozzle; (void)done; return sent('C'); }
+bool PumpTrans_ReadTransaction(GKL_Link *gkl, uint8_t ctrl, uint8_t slave, GKL_Completion *done)
+{ (void)gkl; (void)ctrl; (void)slave; (void)done; return sent('T'); }
+
+void PumpProtoGKL_ReportReply(PumpProtoGKL *gkl, const GKL_Frame *fr)
+{ (void)gkl; (void)fr; }
+
+/* ===== Record sink ===== */
+
+static TrxRecord g_rec[64];
+static uint8_t g_rec_count = 0;
+
+static void on_record(void *ctx, const TrxRecord *r)
+{
+    (void)ctx;
+    if (g_rec_count < 64u) g_rec[g_rec_count++] = *r;
+}
+
+static uint8_t sale_records(void)
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < g_rec_count; i++) {
+        if (g_rec[i].type == TRX_REC_SALE) n++;
+    }
+    return n;
+}
+
+/* ===== Fixture ===== */
+
+#define PUMP_ID  (1u)
+
+static PumpMgr g_mgr;
+static PumpProtoGKL g_gkl;
+static TransactionFSM g_fsm;
+static const PumpProtoVTable g_vt;
+
+static void setup(void)
+{
+    static PumpProto proto;
+    memset(&g_gkl, 0, sizeof(g_gkl));
+    proto.vt = &g_vt;
+    proto.ctx = &g_gkl;
+
+    g_host_tick = 1000u;
+    PumpMgr_Init(&g_mgr, 500u);
+    (void)PumpMgr_Add(&g_mgr, PUMP_ID, &proto, 0x00u, 1u);
+    (void)PumpMgr_SetPrice(&g_mgr, PUMP_ID, 250u);
+
+    TrxFSM_Init(&g_fsm, PUMP_ID, &g_mgr, &g_gkl);
+    TrxFSM_SetRecorder(&g_fsm, on_record, NULL);
+
+    g_sent_len = 0;
+    g_link_busy = false;
+    g_rec_count = 0;
+}
+
+static bool status(uint8_t st)
+{
+    TrxEvent ev = { .type = TRX_EV_STATUS, .status = st };
+    return TrxFSM_Dispatch(&g_fsm, &ev);
+}
+
+static bool timeout(void)
+{
+    TrxEvent ev = { .type = TRX_EV_TIMEOUT };
+    return TrxFSM_Dispatch(&g_fsm, &ev);
+}
+
+/* Manager cache as after a status poll answered dt_ms after now */
+static void pump_polled(uint8_t st, uint32_t dt_ms)
+{
+    g_mgr.hot.status[0] = st;
+    g_mgr.pumps[0].last_status_ms = g_host_tick + dt_ms;
+}
+
+/* Reply to the FSM's own request, collected by the next task pass */
+static void reply(char cmd, const char *data, uint8_t len)
+{
+    memset(&g_fsm.done, 0, sizeof(g_fsm.done));
+    g_fsm.done.frame.cmd = cmd;
+    memcpy(g_fsm.done.frame.data, data, len);
+    g_fsm.done.frame.data_len = len;
+    g_fsm.done.result = GKL_OK;
+    g_fsm.done.done = 1u;
+    TrxFSM_Task(&g_fsm);
+}
+
+/* 'T': nozzle, volume cL (4 BCD), money (4 BCD), price (2 BCD) */
+static void reply_t(void)
+{
+    static const char t[11] = { 1, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x50, 0x00, 0x02, 0x50 };
+    reply('T', t, sizeof(t));
+}
+
+static void armed_sale(void)
+{
+    (void)status(1);
+    CHECK(TrxFSM_StartVolume(&g_fsm, 200u));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_PRESET_SENT);
+    CHECK_EQ(last_sent(), 'V');
+    CHECK(status(3));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_ARMED);
+}
+
+/* ===== Cases ===== */
+
+static void test_guards(void)
+{
+    setup();
+    (void)status(1);
+
+    /* Status values without a row in IDLE change nothing */
+    CHECK(!status(3));
+    CHECK(!status(8));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+
+    /* Commands without a row in IDLE */
+    CHECK(!TrxFSM_Cancel(&g_fsm));
+    CHECK(!TrxFSM_Pause(&g_fsm));
+    CHECK_EQ(g_sent_len, 0u);
+
+    /* Price switch-over pending for this pump: no preset */
+    PumpPriceEntry e = { .id = PUMP_ID, .price = 260u };
+    CHECK(PumpMgr_PriceJobStart(&g_mgr, &e, 1u, 0u));
+    CHECK(!TrxFSM_StartVolume(&g_fsm, 100u));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+    CHECK_EQ(g_sent_len, 0u);
+
+    /* Busy link: command reports failure, state unchanged */
+    setup();
+    (void)status(1);
+    g_link_busy = true;
+    CHECK(!TrxFSM_StartVolume(&g_fsm, 100u));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+}
+
+static void test_sale(void)
+{
+    setup();
+    armed_sale();
+    CHECK(status(4));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_DISPENSING);
+    CHECK(status(8));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_COMPLETE);
+    CHECK(status(9));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK_EQ(last_sent(), 'N');
+    CHECK(status(1));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+
+    CHECK_EQ(sale_records(), 1u);
+    CHECK_EQ(g_rec[g_rec_count - 2u].type, TRX_REC_SALE);
+    CHECK_EQ(g_rec[g_rec_count - 2u].preset, 200u);
+    CHECK_EQ(g_rec[g_rec_count - 2u].price, 250u);
+
+    /* Nothing of this sale is carried into the next one */
+    CHECK_EQ(g_fsm.preset_volume_dL, 0u);
+    CHECK_EQ(g_fsm.sale_price, 0u);
+    CHECK_EQ(g_fsm.target_dL, 0u);
+}
+
+static void test_stale_s9(void)
+{
+    setup();
+    CHECK(status(9));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK_EQ(last_sent(), 'N');
+
+    /* Pump still at S9: 'N' repeated by the timer */
+    CHECK(timeout());
+    CHECK_EQ(g_sent_len, 2u);
+
+    CHECK(status(1));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+    CHECK_EQ(sale_records(), 0u);
+    CHECK(g_rec_count >= 2u);
+}
+
+static void test_preset_timeout(void)
+{
+    setup();
+    (void)status(1);
+    CHECK(TrxFSM_StartMoney(&g_fsm, 5000u));
+    CHECK_EQ(g_fsm.target_dL, 200u);
+
+    /* Not armed in time: authorisation withdrawn at the pump */
+    CHECK(timeout());
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK_EQ(last_sent(), 'N');
+
+    /* Pump armed anyway before 'N' landed: 'N' again */
+    (void)status(3);
+    CHECK(timeout());
+    CHECK_EQ(g_sent_len, 3u);
+
+    CHECK(status(1));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+    CHECK_EQ(sale_records(), 0u);
+
+    /* Busy link at the timeout: stay, the timer retries */
+    setup();
+    (void)status(1);
+    CHECK(TrxFSM_StartVolume(&g_fsm, 100u));
+    g_link_busy = true;
+    CHECK(!timeout());
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_PRESET_SENT);
+    CHECK(g_fsm.timer_armed);
+}
+
+static void test_cancel(void)
+{
+    /* Cancel before the pump armed */
+    setup();
+    (void)status(1);
+    CHECK(TrxFSM_StartVolume(&g_fsm, 100u));
+    CHECK(TrxFSM_Cancel(&g_fsm));
+    CHECK_EQ(last_sent(), 'N');
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+
+    /* The S1 from before the 'N' does not close it ... */
+    pump_polled(1u, 0u);
+    CHECK(!timeout());
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+
+    /* ... an S1 polled after it does, though the status never changed */
+    pump_polled(1u, 10u);
+    CHECK(timeout());
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+    CHECK_EQ(sale_records(), 0u);
+
+    /* Cancel while armed */
+    setup();
+    armed_sale();
+    CHECK(TrxFSM_Cancel(&g_fsm));
+    CHECK_EQ(last_sent(), 'N');
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK(status(1));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+    CHECK_EQ(sale_records(), 0u);
+
+    /* Cancel while dispensing ends a real sale */
+    setup();
+    armed_sale();
+    CHECK(status(4));
+    CHECK(TrxFSM_Cancel(&g_fsm));
+    CHECK_EQ(last_sent(), 'N');
+    CHECK(status(1));
+    CHECK_EQ(sale_records(), 1u);
+
+    /* Busy link: Cancel reports failure and nothing moves */
+    setup();
+    armed_sale();
+    g_link_busy = true;
+    CHECK(!TrxFSM_Cancel(&g_fsm));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_ARMED);
+}
+
+static void test_final_reads(void)
+{
+    setup();
+    armed_sale();
+    CHECK(status(4));
+    CHECK(status(8));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_COMPLETE);
+
+    CHECK(timeout());
+    CHECK_EQ(last_sent(), 'T');
+    reply_t();
+    CHECK(g_fsm.trx_valid);
+    CHECK_EQ(g_fsm.trx_volume_dL, 200u);
+
+    /* 'C' goes out on the FSM's own slot and lands in the manager cache */
+    CHECK(timeout());
+    CHECK_EQ(last_sent(), 'C');
+    reply('C', "1 000012345", 11u);
+    CHECK(g_fsm.tot_after_valid);
+    CHECK_EQ(g_fsm.tot_after_cL, 12345u);
+    PumpTotalizer tot;
+    CHECK(PumpMgr_GetTotalizer(&g_mgr, PUMP_ID, 1u, &tot));
+    CHECK(tot.valid);
+    CHECK_EQ(tot.value, 12345u);
+
+    /* Nothing left to read */
+    uint8_t n = g_sent_len;
+    CHECK(timeout());
+    CHECK_EQ(g_sent_len, n);
+}
+
+static void test_zero_volume(void)
+{
+    setup();
+    PumpMgr_PutTotalizer(&g_mgr, PUMP_ID, 1u, 5000u);
+    armed_sale();
+    CHECK(status(4));
+    CHECK(status(8));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_COMPLETE);
+    CHECK(timeout());
+    reply_t();
+
+    /* Background read after S8, same value: no notification, still taken */
+    g_host_tick += 10u;
+    PumpMgr_PutTotalizer(&g_mgr, PUMP_ID, 1u, 5000u);
+    uint8_t n = g_sent_len;
+    CHECK(timeout());
+    CHECK_EQ(g_sent_len, n);
+    CHECK(g_fsm.tot_after_valid);
+    CHECK_EQ(g_fsm.tot_after_cL, 5000u);
+    CHECK_EQ(g_fsm.c_tries, 0u);
+}
+
+/* Status rows for statuses missed between two polls, and the pump acting
+   on its own: each path still records a SALE, or none without fuel */
+static void test_missed_status(void)
+{
+    /* S8 straight after the preset */
+    setup();
+    (void)status(1);
+    CHECK(TrxFSM_StartVolume(&g_fsm, 100u));
+    CHECK(status(8));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_COMPLETE);
+    CHECK(status(9));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK(status(1));
+    CHECK_EQ(sale_records(), 1u);
+
+    /* S9 straight after the preset: via COMPLETE, 'N' sent at once */
+    setup();
+    (void)status(1);
+    CHECK(TrxFSM_StartVolume(&g_fsm, 100u));
+    CHECK(status(9));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK_EQ(last_sent(), 'N');
+    CHECK(status(1));
+    CHECK_EQ(sale_records(), 1u);
+
+    /* S8 while armed */
+    setup();
+    armed_sale();
+    CHECK(status(8));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_COMPLETE);
+
+    /* S9 while dispensing, S8 missed */
+    setup();
+    armed_sale();
+    CHECK(status(4));
+    CHECK(status(9));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK_EQ(last_sent(), 'N');
+    CHECK(status(1));
+    CHECK_EQ(sale_records(), 1u);
+}
+
+static void test_armed(void)
+{
+    /* Authorisation ended at the pump: back to idle, no sale, no 'N' */
+    setup();
+    armed_sale();
+    uint8_t n = g_sent_len;
+    CHECK(status(1));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+    CHECK_EQ(g_sent_len, n);
+    CHECK_EQ(sale_records(), 0u);
+
+    /* Nozzle never lifted: withdrawn when the armed timer runs out */
+    setup();
+    armed_sale();
+    CHECK(g_fsm.timer_armed);
+    CHECK_EQ(g_fsm.timer_deadline_ms - g_host_tick, TRX_FSM_ARMED_TIMEOUT_MS);
+    CHECK(timeout());
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK_EQ(last_sent(), 'N');
+    CHECK(status(1));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_IDLE);
+    CHECK_EQ(sale_records(), 0u);
+}
+
+static void test_paused(void)
+{
+    /* Flow statuses do not undo the Stop; the sale ends at the pump */
+    setup();
+    armed_sale();
+    CHECK(status(4));
+    CHECK(TrxFSM_Pause(&g_fsm));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_PAUSED);
+    CHECK(!status(6));
+    CHECK(!status(4));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_PAUSED);
+    CHECK(status(8));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_COMPLETE);
+
+    /* Nozzle hung up while stopped */
+    setup();
+    armed_sale();
+    CHECK(status(4));
+    CHECK(TrxFSM_Pause(&g_fsm));
+    CHECK(status(9));
+    CHECK_EQ(TrxFSM_GetState(&g_fsm), TRX_CLOSING);
+    CHECK(status(1));
+    CHECK_EQ(sale_records(), 1u);
+}
+
+/* Full site: 32 FSMs plus the app's two hooks and the UI share one table */
+static PumpEvent g_ev;
+static bool g_ev_pending = false;
+
+static bool site_pop(void *ctx, PumpEvent *out)
+{
+    (void)ctx;
+    if (!g_ev_pending) return false;
+    *out = g_ev;
+    g_ev_pending = false;
+    return true;
+}
+
+static unsigned g_site_notes = 0;
+static void site_note(void *ctx, const PumpMgrNotify *n) { (void)ctx; (void)n; g_site_notes++; }
+
+static void test_subscriptions(void)
+{
+    static PumpMgr mgr;
+    static TransactionFSM fsm[PUMP_MGR_MAX_PUMPS];
+    static const PumpProtoVTable vt = { .pop_event = site_pop };
+    PumpProto proto = { .vt = &vt, .ctx = &g_gkl };
+
+    setup();
+    PumpMgr_Init(&mgr, 500u);
+    for (uint8_t i = 0; i < PUMP_MGR_MAX_PUMPS; i++) {
+        CHECK(PumpMgr_Add(&mgr, (uint8_t)(i + 1u), &proto, 0x00u, (uint8_t)(i + 1u)));
+        CHECK(TrxFSM_Init(&fsm[i], (uint8_t)(i + 1u), &mgr, &g_gkl));
+    }
+    /* app price + totalizer hooks, UI redraw */
+    CHECK(PumpMgr_Subscribe(&mgr, 0, PUMP_MGR_NOTIFY_PRICE, site_note, NULL) != 0);
+    CHECK(PumpMgr_Subscribe(&mgr, 0, PUMP_MGR_NOTIFY_TOTALIZER, site_note, NULL) != 0);
+    CHECK(PumpMgr_Subscribe(&mgr, 0, PUMP_MGR_NOTIFY_STATUS | PUMP_MGR_NOTIFY_PRICE, site_note, NULL) != 0);
+
+    /* The last pump's FSM still hears its status */
+    memset(&g_ev, 0, sizeof(g_ev));
+    g_ev.type = PUMP_EVT_STATUS;
+    g_ev.slave_addr = PUMP_MGR_MAX_PUMPS;
+    g_ev.status = 9u;
+    g_ev_pending = true;
+    g_site_notes = 0;
+    PumpMgr_Task(&mgr);
+    CHECK_EQ(TrxFSM_GetState(&fsm[PUMP_MGR_MAX_PUMPS - 1u]), TRX_CLOSING);
+    CHECK_EQ(TrxFSM_GetState(&fsm[0]), TRX_IDLE);
+    CHECK_EQ(g_site_notes, 1u);
+}
+
+int main(void)
+{
+    test_guards();
+    test_sale();
+    test_stale_s9();
+    test_preset_timeout();
+    test_cancel();
+    test_final_reads();
+    test_zero_volume();
+    test_missed_status();
+    test_armed();
+    test_paused();
+    test_subscriptions();
+    return host_report("test_transaction_fsm");
+}
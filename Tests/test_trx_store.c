@@ -0,0 +1,122 @@
+/* test_trx_store.c - Sales store on the host: per-pump index for the
+   highest pump id, time queries across the tick wrap, sales leaving the
+   time span, restored sales kept out of time queries. */
+#include "host_stub.h"
+#include "trx_store.h"
+#include <string.h>
+
+static TrxStore g_st;
+
+static uint32_t close_sale(uint8_t pump_id, uint32_t volume_dL, uint32_t end_ms)
+{
+    TrxRecord r;
+    memset(&r, 0, sizeof(r));
+    r.type = TRX_REC_SALE;
+    r.pump_id = pump_id;
+    r.volume_dL = volume_dL;
+    return TrxStore_CloseSale(&g_st, &r, end_ms);
+}
+
+/* Sales a query returns, and the volume of the first one */
+static uint32_t query(uint8_t pump_id, uint32_t from_ms, uint32_t to_ms, uint32_t *first_dL)
+{
+    TrxStoreCursor c;
+    TrxSale s;
+    uint32_t n = 0u;
+
+    TrxStore_Seek(&g_st, &c, pump_id, 0u, from_ms, to_ms);
+    while (TrxStore_Next(&g_st, &c, &s))
+    {
+        if (n == 0u && first_dL != NULL) *first_dL = s.volume_dL;
+        n++;
+    }
+    return n;
+}
+
+/* ===== Cases ===== */
+
+static void test_index(void)
+{
+    uint32_t first = 0u;
+
+    TrxStore_Init(&g_st);
+    CHECK(close_sale(PUMP_MGR_MAX_PUMPS, 10u, 100u) != 0u);
+    CHECK(close_sale(1u, 20u, 200u) != 0u);
+    CHECK(close_sale(PUMP_MGR_MAX_PUMPS, 30u, 300u) != 0u);
+
+    CHECK_EQ(query(PUMP_MGR_MAX_PUMPS, 150u, 400u, &first), 1u);
+    CHECK_EQ(first, 30u);
+    CHECK_EQ(query(0u, 0u, 400u, NULL), 3u);
+
+    /* Totalizer after goes to that pump's newest sale */
+    TrxStore_SetTotalizerAfter(&g_st, PUMP_MGR_MAX_PUMPS, 1u, 777u);
+    TrxSale s;
+    CHECK(TrxStore_Get(&g_st, 3u, &s));
+    CHECK(s.flags & TRX_SALE_F_TOT_AFTER);
+    CHECK_EQ(s.tot_after_cL, 777u);
+}
+
+static void test_wrap(void)
+{
+    uint32_t first = 0u;
+
+    /* Sales on both sides of the tick wrap stay in order */
+    TrxStore_Init(&g_st);
+    (void)close_sale(1u, 10u, 0xFFFFFF00u);
+    (void)close_sale(1u, 20u, 0xFFFFFFF0u);
+    (void)close_sale(1u, 30u, 0x00000010u);
+    (void)close_sale(2u, 40u, 0x00000100u);
+
+    CHECK_EQ(query(0u, 0xFFFFFFF0u, 0x00000010u, &first), 2u);
+    CHECK_EQ(first, 20u);
+    CHECK_EQ(query(1u, 0xFFFFFFF8u, 0x00001000u, &first), 1u);
+    CHECK_EQ(first, 30u);
+
+    /* A sale more than the span after the oldest pushes it out of time
+       queries; it is still there by seq */
+    (void)close_sale(1u, 50u, 0xFFFFFF00u + TRX_STORE_TIME_SPAN_MS + 1u);
+    CHECK_EQ(g_st.time_seq, 2u);
+    CHECK_EQ(query(1u, 0xFFFFFF00u + TRX_STORE_TIME_SPAN_MS - 0x1000u,
+                   0xFFFFFF00u + TRX_STORE_TIME_SPAN_MS + 1u, &first), 1u);
+    CHECK_EQ(first, 50u);
+    TrxSale s;
+    CHECK(TrxStore_Get(&g_st, 1u, &s));
+    CHECK_EQ(s.volume_dL, 10u);
+}
+
+static void test_restored(void)
+{
+    TrxRecord r;
+    memset(&r, 0, sizeof(r));
+    r.type = TRX_REC_SALE;
+    r.pump_id = 2u;
+
+    TrxStore_Init(&g_st);
+    r.sale_id = 40u;
+    CHECK(TrxStore_Restore(&g_st, &r));
+    r.sale_id = 42u;
+    CHECK(TrxStore_Restore(&g_st, &r));
+    r.sale_id = 41u;
+    CHECK(!TrxStore_Restore(&g_st, &r));
+
+    TrxSale s;
+    CHECK(TrxStore_Get(&g_st, 42u, &s));
+    CHECK(s.flags & TRX_SALE_F_RESTORED);
+    CHECK_EQ(s.end_ms, 0u);
+
+    /* No tick: not in any time range, for the pump or for all pumps */
+    CHECK_EQ(query(0u, 0u, 0xFFFFFFFFu, NULL), 0u);
+    CHECK_EQ(query(2u, 0u, 0u, NULL), 0u);
+
+    /* Live sales number on and are found */
+    CHECK_EQ(close_sale(2u, 5u, 1000u), 43u);
+    CHECK_EQ(query(2u, 0u, 2000u, NULL), 1u);
+}
+
+int main(void)
+{
+    test_index();
+    test_wrap();
+    test_restored();
+    return host_report("test_trx_store");
+}
@@ -24,6 +24,7 @@
 /* USER CODE BEGIN INCLUDE */
 
 #include "cdc_logger.h"
+#include "host_cmd.h"
 
 /* USER CODE END INCLUDE */
 
@@ -263,6 +264,7 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
+  HostCmd_OnRx(Buf, *Len);
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
   USBD_CDC_ReceivePacket(&hUsbDeviceFS);
   return (USBD_OK);